@@ -0,0 +1,61 @@
+// Checks libwinzig through its C API alone: every program given on the
+// command line must parse, and the same program cut short, or followed by
+// stray text, must be a syntax error. Built by `make test`; not part of
+// winzigc itself.
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "winzig.h"
+
+using namespace std;
+
+static winzig_status parse(const string& source, string& error) {
+    winzig_tree* tree = nullptr;
+    winzig_status status = winzig_parse(source.data(), source.size(), nullptr, &tree);
+    error = tree ? winzig_error(tree) : "";
+    winzig_free(tree);
+    return status;
+}
+
+// Reports a mismatch and returns false
+static bool expect(const string& name, const string& source, winzig_status wanted) {
+    string error;
+    winzig_status status = parse(source, error);
+    if (status == wanted) return true;
+    cerr << name << ": winzig_parse returned " << status << ", expected " << wanted;
+    if (!error.empty()) cerr << " (" << error << ")";
+    cerr << endl;
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    bool passed = expect("program x: begin", "program x: begin", WINZIG_ERR_SYNTAX);
+
+    for (int i = 1; i < argc; i++) {
+        ifstream file(argv[i], ios::binary);
+        if (!file) {
+            cerr << "Error: Cannot open file " << argv[i] << endl;
+            return 1;
+        }
+        stringstream buffer;
+        buffer << file.rdbuf();
+        string source = buffer.str();
+        string name = argv[i];
+
+        passed &= expect(name, source, WINZIG_OK);
+        size_t dot = source.rfind('.');
+        if (dot == string::npos) {
+            cerr << name << ": no final '.'" << endl;
+            passed = false;
+            continue;
+        }
+        passed &= expect(name + " without its final '.'", source.substr(0, dot), WINZIG_ERR_SYNTAX);
+        passed &= expect(name + " cut in half", source.substr(0, source.size() / 2), WINZIG_ERR_SYNTAX);
+        passed &= expect(name + " with text after '.'", source + "\nbegin end x.\n", WINZIG_ERR_SYNTAX);
+    }
+
+    if (!passed) return 1;
+    cout << "libwinzig: " << argc - 1 << " programs parsed, truncated inputs rejected" << endl;
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include "ast_index.h"
+#include "symbols.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+static bool isLiteralWrapper(const ASTNode* node) {
+    return !node->nodeType.empty() && node->nodeType[0] == '<' && node->children.size() == 1 &&
+           node->children[0]->children.empty();
+}
+
+AstQuery::AstQuery(const string& pattern) : anchored(false) {
+    size_t pos = 0;
+    if (pattern.compare(0, 2, "//") == 0) {
+        pos = 2;
+    } else if (pattern.compare(0, 1, "/") == 0) {
+        anchored = true;
+        pos = 1;
+    }
+
+    bool descendant = false;
+    while (true) {
+        Step step;
+        step.descendant = descendant;
+        size_t start = pos;
+        while (pos < pattern.size() && pattern[pos] != '/' && pattern[pos] != '[') pos++;
+        step.kind = pattern.substr(start, pos - start);
+        if (step.kind.empty()) throw runtime_error("empty step in query '" + pattern + "'");
+        if (step.kind == "*") step.kind.clear();
+
+        while (pos < pattern.size() && pattern[pos] == '[') {
+            size_t close = pattern.find(']', pos);
+            if (close == string::npos) throw runtime_error("unterminated '[' in query '" + pattern + "'");
+            string predicate = pattern.substr(pos + 1, close - pos - 1);
+            size_t eq = predicate.find('=');
+            string key = predicate.substr(0, eq);
+            string name = eq == string::npos ? "" : predicate.substr(eq + 1);
+            if (eq == string::npos || name.empty()) {
+                throw runtime_error("predicate '[" + predicate + "]' needs a name after '='");
+            }
+            if (key.empty()) {
+                step.text = name;
+            } else if (key == "identifier" || key == "<identifier>") {
+                step.childName = name;
+            } else if (key == "//identifier" || key == "//<identifier>") {
+                step.descendantName = name;
+            } else {
+                throw runtime_error("unknown predicate '[" + predicate + "]'");
+            }
+            pos = close + 1;
+        }
+        steps.push_back(step);
+
+        if (pos == pattern.size()) break;
+        if (pattern[pos] != '/') throw runtime_error("unexpected '" + string(1, pattern[pos]) + "' in query");
+        pos++;
+        descendant = pos < pattern.size() && pattern[pos] == '/';
+        if (descendant) pos++;
+    }
+}
+
+const AstIndex::NodeId AstIndex::NONE;
+
+AstIndex::AstIndex(const ASTNode* root) {
+    build(root);
+}
+
+void AstIndex::build(const ASTNode* root) {
+    // Iterative preorder walk; an expression chain can nest deeper than the
+    // call stack allows
+    struct Frame {
+        const ASTNode* node;
+        NodeId id;
+        size_t next;
+    };
+    vector<Frame> stack;
+
+    nodes.push_back(root);
+    parents.push_back(NONE);
+    ends.push_back(0);
+    positions.push_back(0);
+    Frame first = {root, 0, 0};
+    stack.push_back(first);
+
+    while (!stack.empty()) {
+        Frame& top = stack.back();
+        if (top.next == top.node->children.size()) {
+            ends[top.id] = (NodeId)nodes.size();
+            stack.pop_back();
+            continue;
+        }
+        const ASTNode* child = top.node->children[top.next];
+        NodeId id = (NodeId)nodes.size();
+        nodes.push_back(child);
+        parents.push_back(top.id);
+        ends.push_back(0);
+        positions.push_back((uint32_t)top.next);
+        top.next++;
+        Frame frame = {child, id, 0};
+        stack.push_back(frame);
+    }
+
+    for (NodeId id = 0; id < nodes.size(); id++) {
+        const ASTNode* node = nodes[id];
+        // A text leaf's nodeType is source text, which may spell a kind
+        if (node->kind != NK_TEXT) kinds[node->nodeType].push_back(id);
+        if (node->nodeType == "<identifier>" && isLiteralWrapper(node)) {
+            identifiers[leafText(node)].push_back(id);
+        }
+    }
+}
+
+const vector<AstIndex::NodeId>& AstIndex::nodesOfKind(const string& kind) const {
+    unordered_map<string, vector<NodeId> >::const_iterator it = kinds.find(kind);
+    return it == kinds.end() ? noNodes : it->second;
+}
+
+const vector<AstIndex::NodeId>& AstIndex::identifierUses(const string& name) const {
+    unordered_map<string, vector<NodeId> >::const_iterator it = identifiers.find(name);
+    return it == identifiers.end() ? noNodes : it->second;
+}
+
+string AstIndex::resolveKind(const string& kind) const {
+    // Let patterns write identifier for <identifier>
+    if (kind.empty() || kinds.count(kind)) return kind;
+    string bracketed = "<" + kind + ">";
+    return kinds.count(bracketed) ? bracketed : kind;
+}
+
+bool AstIndex::stepMatches(const AstQuery::Step& step, NodeId id) const {
+    const ASTNode* node = nodes[id];
+    // Steps name node kinds; text is matched through [=X] and [identifier=X]
+    if (node->kind == NK_TEXT) return false;
+    if (!step.kind.empty() && node->nodeType != step.kind) return false;
+    if (!step.text.empty() && !(isLiteralWrapper(node) && leafText(node) == step.text)) return false;
+
+    if (!step.childName.empty()) {
+        bool found = false;
+        for (size_t i = 0; i < node->children.size() && !found; i++) {
+            const ASTNode* child = node->children[i];
+            found = child->nodeType == "<identifier>" && leafText(child) == step.childName;
+        }
+        if (!found) return false;
+    }
+
+    if (!step.descendantName.empty()) {
+        // Any use whose preorder id falls inside this subtree
+        const vector<NodeId>& uses = identifierUses(step.descendantName);
+        vector<NodeId>::const_iterator it = upper_bound(uses.begin(), uses.end(), id);
+        if (it == uses.end() || *it >= ends[id]) return false;
+    }
+    return true;
+}
+
+bool AstIndex::matchesUpward(const AstQuery& query, size_t step, NodeId id) const {
+    if (step == 0) return !query.anchored || id == 0;
+
+    const AstQuery::Step& previous = query.steps[step - 1];
+    NodeId up = parents[id];
+    if (!query.steps[step].descendant) {
+        return up != NONE && stepMatches(previous, up) && matchesUpward(query, step - 1, up);
+    }
+    for (; up != NONE; up = parents[up]) {
+        if (stepMatches(previous, up) && matchesUpward(query, step - 1, up)) return true;
+    }
+    return false;
+}
+
+vector<AstIndex::NodeId> AstIndex::find(const AstQuery& pattern) const {
+    AstQuery query = pattern;
+    for (size_t i = 0; i < query.steps.size(); i++) query.steps[i].kind = resolveKind(query.steps[i].kind);
+    const AstQuery::Step& last = query.steps.back();
+    const string& kind = last.kind;
+
+    // Start from the smallest posting list that covers the last step
+    vector<NodeId> candidates;
+    if (!last.text.empty() && kind == "<identifier>") {
+        candidates = identifierUses(last.text);
+    } else if (!last.childName.empty()) {
+        const vector<NodeId>& uses = identifierUses(last.childName);
+        for (size_t i = 0; i < uses.size(); i++) candidates.push_back(parents[uses[i]]);
+        sort(candidates.begin(), candidates.end());
+        candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+    } else if (!kind.empty()) {
+        candidates = nodesOfKind(kind);
+    } else {
+        candidates.resize(nodes.size());
+        for (NodeId id = 0; id < nodes.size(); id++) candidates[id] = id;
+    }
+
+    vector<NodeId> matches;
+    for (size_t i = 0; i < candidates.size(); i++) {
+        NodeId id = candidates[i];
+        if (stepMatches(last, id) && matchesUpward(query, query.steps.size() - 1, id)) {
+            matches.push_back(id);
+        }
+    }
+    return matches;
+}
+
+vector<const ASTNode*> AstIndex::query(const string& pattern) const {
+    vector<NodeId> ids = find(AstQuery(pattern));
+    vector<const ASTNode*> result(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) result[i] = nodes[ids[i]];
+    return result;
+}
+
+string AstIndex::path(NodeId id) const {
+    vector<NodeId> chain;
+    for (NodeId up = id; up != NONE; up = parents[up]) chain.push_back(up);
+
+    string result;
+    for (size_t i = chain.size(); i-- > 0;) {
+        NodeId step = chain[i];
+        if (!result.empty()) result += "/";
+        result += nodes[step]->nodeType;
+        if (step != 0) result += "[" + to_string(positions[step]) + "]";
+    }
+    return result;
+}
@@ -1,39 +1,189 @@
 #include "ast_node.h"
+#include "node_arena.h"
+#include "node_interner.h"
+#include "memory_profiler.h"
+#include "ast_visitor.h"
 
 using namespace std;
 
+NodeKind classifyNodeType(const string& type) {
+    // Dispatch on the first character so each name costs one or two compares
+    if (type.empty()) return NK_UNKNOWN;
+    switch (type[0]) {
+        case '*':
+            if (type == "*") return NK_MUL;
+            break;
+        case '+':
+            if (type == "+") return NK_PLUS;
+            break;
+        case '-':
+            if (type == "-") return NK_MINUS;
+            break;
+        case '.':
+            if (type == "..") return NK_RANGE;
+            break;
+        case '/':
+            if (type == "/") return NK_DIV;
+            break;
+        case '<':
+            if (type == "<identifier>") return NK_IDENTIFIER;
+            if (type == "<integer>") return NK_INTEGER;
+            if (type == "<string>") return NK_STRING;
+            if (type == "<null>") return NK_NULL;
+            if (type == "<char>") return NK_CHAR;
+            if (type == "<=") return NK_LE;
+            if (type == "<>") return NK_NE;
+            if (type == "<") return NK_LT;
+            break;
+        case '=':
+            if (type == "=") return NK_EQ;
+            break;
+        case '>':
+            if (type == ">=") return NK_GE;
+            if (type == ">") return NK_GT;
+            break;
+        case 'a':
+            if (type == "assign") return NK_ASSIGN;
+            if (type == "and") return NK_AND;
+            break;
+        case 'b':
+            if (type == "block") return NK_BLOCK;
+            break;
+        case 'c':
+            if (type == "case_clause") return NK_CASE_CLAUSE;
+            if (type == "consts") return NK_CONSTS;
+            if (type == "const") return NK_CONST;
+            if (type == "case") return NK_CASE;
+            if (type == "call") return NK_CALL;
+            if (type == "chr") return NK_CHR;
+            break;
+        case 'd':
+            if (type == "dclns") return NK_DCLNS;
+            break;
+        case 'e':
+            if (type == "exit") return NK_EXIT;
+            if (type == "eof") return NK_EOF;
+            break;
+        case 'f':
+            if (type == "fcn") return NK_FCN;
+            if (type == "for") return NK_FOR;
+            break;
+        case 'i':
+            if (type == "integer") return NK_OUTPUT_INTEGER;
+            if (type == "if") return NK_IF;
+            break;
+        case 'l':
+            if (type == "loop") return NK_LOOP;
+            if (type == "lit") return NK_LIT;
+            break;
+        case 'm':
+            if (type == "mod") return NK_MOD;
+            break;
+        case 'n':
+            if (type == "not") return NK_NOT;
+            break;
+        case 'o':
+            if (type == "otherwise") return NK_OTHERWISE;
+            if (type == "output") return NK_OUTPUT;
+            if (type == "ord") return NK_ORD;
+            if (type == "or") return NK_OR;
+            break;
+        case 'p':
+            if (type == "program") return NK_PROGRAM;
+            if (type == "params") return NK_PARAMS;
+            if (type == "pred") return NK_PRED;
+            break;
+        case 'r':
+            if (type == "repeat") return NK_REPEAT;
+            if (type == "return") return NK_RETURN;
+            if (type == "read") return NK_READ;
+            break;
+        case 's':
+            if (type == "subprogs") return NK_SUBPROGS;
+            if (type == "string") return NK_OUTPUT_STRING;
+            if (type == "swap") return NK_SWAP;
+            if (type == "succ") return NK_SUCC;
+            break;
+        case 't':
+            if (type == "types") return NK_TYPES;
+            if (type == "type") return NK_TYPE;
+            if (type == "true") return NK_TRUE;
+            break;
+        case 'v':
+            if (type == "var") return NK_VAR;
+            break;
+        case 'w':
+            if (type == "while") return NK_WHILE;
+            break;
+        default:
+            break;
+    }
+    return NK_UNKNOWN;
+}
+
+const char* nodeKindName(NodeKind kind) {
+    // In enum order
+    static const char* const names[NK_KIND_COUNT] = {
+        "unknown", "text", "program", "consts", "const", "types", "type", "lit", "dclns", "var",
+        "subprogs", "fcn", "params", "block", "assign", "swap", "output", "if", "while", "repeat",
+        "for", "loop", "case", "case_clause", "..", "otherwise", "read", "exit", "return",
+        "<null>", "integer", "string", "<identifier>", "<integer>", "<char>", "<string>", "true",
+        "<=", "<", ">=", ">", "=", "<>", "+", "-", "or", "*", "/", "and", "mod", "not",
+        "succ", "pred", "chr", "ord", "eof", "call"
+    };
+    return kind < NK_KIND_COUNT ? names[kind] : "unknown";
+}
+
+void* ASTNode::operator new(size_t bytes) {
+    NodeArena* arena = NodeArena::active();
+    void* p = arena ? arena->allocate(bytes) : ::operator new(bytes);
+    MemoryProfiler::noteNew(p);
+    return p;
+}
+
+void ASTNode::operator delete(void* p) {
+    MemoryProfiler::noteDelete(p);
+    NodeArena* arena = NodeArena::active();
+    if (arena && arena->releaseLast(p)) return;
+    ::operator delete(p);
+}
+
 void ASTNode::addChild(ASTNode* child) {
-    if (child) children.push_back(child);
+    if (!child) return;
+    // Children are complete when attached, so this is where hash-consing happens
+    size_t capacity = children.capacity();
+    children.push_back(NodeInterner::share(child));
+    MemoryProfiler::noteChild(this, capacity);
 }
 
-void ASTNode::print(int depth, bool isLast) const {
-    // Print indentation
-    for (int i = 0; i < depth; i++) {
-        cout << ". ";
-    }
-    
-    // Print node type and child count
-    cout << nodeType << "(" << children.size() << ")";
-    
-    // Print value if it's a leaf node
-    if (children.empty() && !value.empty()) {
-        cout << "\n";
-        for (int i = 0; i <= depth; i++) {
-            cout << ". ";
+// The -ast text format: ". " per level, then type(child count); a
+// childless node with a value prints it on an extra line below
+class TreePrinter : public AstVisitor<TreePrinter> {
+public:
+    TreePrinter(ostream& os, int baseDepth) : out(os), base(baseDepth) {}
+
+    VisitAction pre(const ASTNode* node, int depth) {
+        // Every node below the starting one is on its own line
+        if (depth > base) out << "\n";
+        indent(depth);
+        out << node->nodeType << "(" << node->children.size() << ")";
+        if (node->children.empty() && !node->value.empty()) {
+            out << "\n";
+            indent(depth + 1);
+            out << node->value << "(0)";
         }
-        cout << value << "(0)";
-    }
-    
-    // Print children
-    for (size_t i = 0; i < children.size(); i++) {
-        cout << "\n";
-        children[i]->print(depth + 1, false);
+        return VISIT_CHILDREN;
     }
-    
-    // Only add final newline if this is not the root node or not the last element
-    if (depth == 0 && isLast) {
-        // Don't add newline for the root node when it's the last
-    } else if (depth > 0) {
-        // For non-root nodes, newlines are handled by the parent
+
+private:
+    ostream& out;
+    int base;
+
+    void indent(int depth) {
+        for (int i = 0; i < depth; i++) out << ". ";
     }
+};
+
+void ASTNode::print(int depth, bool, ostream& out) const {
+    TreePrinter(out, depth).walk(this, depth);
 }
@@ -0,0 +1,385 @@
+#include "c_emitter.h"
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+// True if evaluating the expression can observe or change program state
+// (function calls and eof), so operand order must be made explicit in C.
+static bool hasEffects(const ASTNode* node) {
+    if (!node) return false;
+    if (node->nodeType == "call" || node->nodeType == "eof") return true;
+    for (size_t i = 0; i < node->children.size(); i++) {
+        if (hasEffects(node->children[i])) return true;
+    }
+    return false;
+}
+
+static string cString(const string& literal) {
+    // Strip the surrounding quotes kept by the lexer
+    string body = literal;
+    if (body.size() >= 2 && body[0] == '"') body = body.substr(1, body.size() - 2);
+
+    string result = "\"";
+    for (size_t i = 0; i < body.size(); i++) {
+        char c = body[i];
+        if (c == '\\' || c == '"') {
+            result += '\\';
+            result += c;
+        } else if (c == '\n') {
+            result += "\\n";
+        } else if (c == '\t') {
+            result += "\\t";
+        } else {
+            result += c;
+        }
+    }
+    return result + "\"";
+}
+
+static string cInt(int value) {
+    if (value == (-2147483647 - 1)) return "(-2147483647 - 1)";
+    ostringstream os;
+    os << value;
+    return os.str();
+}
+
+CEmitter::CEmitter(ostream& os, const ProgramInfo& programInfo)
+    : out(os), info(programInfo), current(nullptr), labelCounter(0), tempCounter(0) {}
+
+string CEmitter::pad(int indent) const {
+    return string(indent * 4, ' ');
+}
+
+void CEmitter::emit(const ASTNode* program) {
+    out << "/* Generated by winzigc -emit-c from program " << info.name << " */\n";
+    emitRuntime();
+
+    // Globals, including variables that are only ever assigned implicitly
+    for (size_t i = 0; i < info.globals.vars.size(); i++) {
+        out << "static int wz_" << info.globals.vars[i] << ";\n";
+    }
+    out << "\n";
+
+    // Prototypes allow mutual recursion between functions
+    for (size_t i = 0; i < info.functions.size(); i++) {
+        const FunctionInfo& fn = info.functions[i];
+        out << "static int wzf_" << fn.name << "(";
+        for (size_t j = 0; j < fn.params.size(); j++) {
+            out << (j ? ", " : "") << "int wz_" << fn.params[j];
+        }
+        out << (fn.params.empty() ? "void" : "") << ");\n";
+    }
+    out << "\n";
+
+    for (size_t i = 0; i < info.functions.size(); i++) {
+        emitFunction(info.functions[i]);
+    }
+
+    // Main block
+    ostringstream body;
+    {
+        CEmitter bodyEmitter(body, info);
+        bodyEmitter.emitStatement(program->children[5], 1);
+        tempCounter = bodyEmitter.tempCounter;
+    }
+    out << "int main(void)\n{\n";
+    for (int t = 0; t < tempCounter; t++) out << "    int wzt_" << t << ";\n";
+    out << body.str();
+    out << "    return 0;\n}\n";
+}
+
+void CEmitter::emitRuntime() {
+    out << "#include <stdio.h>\n"
+           "#include <stdlib.h>\n"
+           "\n"
+           "#ifdef __GNUC__\n"
+           "#define WZ_RT static __attribute__((unused))\n"
+           "#else\n"
+           "#define WZ_RT static\n"
+           "#endif\n"
+           "\n"
+           "#define WZ_ADD(a, b) ((int)((unsigned)(a) + (unsigned)(b)))\n"
+           "#define WZ_SUB(a, b) ((int)((unsigned)(a) - (unsigned)(b)))\n"
+           "#define WZ_MUL(a, b) ((int)((unsigned)(a) * (unsigned)(b)))\n"
+           "#define WZ_NEG(a) ((int)(0u - (unsigned)(a)))\n"
+           "\n"
+           "WZ_RT int wzrt_skip(void)\n{\n"
+           "    int c;\n"
+           "    do c = getchar(); while (c == ' ' || c == '\\t' || c == '\\n' || c == '\\r');\n"
+           "    if (c != EOF) ungetc(c, stdin);\n"
+           "    return c;\n}\n"
+           "\n"
+           "WZ_RT int wzrt_eof(void) { return wzrt_skip() == EOF; }\n"
+           "\n"
+           "WZ_RT int wzrt_read_int(void)\n{\n"
+           "    int v = 0;\n"
+           "    wzrt_skip();\n"
+           "    if (scanf(\"%d\", &v) == 0) getchar();\n"
+           "    return v;\n}\n"
+           "\n"
+           "WZ_RT int wzrt_read_char(void)\n{\n"
+           "    int c;\n"
+           "    wzrt_skip();\n"
+           "    c = getchar();\n"
+           "    return c == EOF ? 0 : c;\n}\n"
+           "\n"
+           "WZ_RT int wzrt_check(int b)\n{\n"
+           "    if (b == 0) {\n"
+           "        fflush(stdout);\n"
+           "        fputs(\"Error: division by zero\\n\", stderr);\n"
+           "        exit(1);\n"
+           "    }\n"
+           "    return b;\n}\n"
+           "\n"
+           "WZ_RT int wzrt_div(int a, int b) { return wzrt_check(b) == -1 ? WZ_NEG(a) : a / b; }\n"
+           "WZ_RT int wzrt_mod(int a, int b) { return wzrt_check(b) == -1 ? 0 : a % b; }\n"
+           "\n";
+}
+
+void CEmitter::emitFunction(const FunctionInfo& fn) {
+    ostringstream body;
+    {
+        // Emit the body first so the temporaries it needs are known
+        CEmitter bodyEmitter(body, info);
+        bodyEmitter.current = &fn;
+        bodyEmitter.emitStatement(fn.node->children[6], 1);
+        tempCounter = bodyEmitter.tempCounter;
+    }
+
+    out << "static int wzf_" << fn.name << "(";
+    for (size_t j = 0; j < fn.params.size(); j++) {
+        out << (j ? ", " : "") << "int wz_" << fn.params[j];
+    }
+    out << (fn.params.empty() ? "void" : "") << ")\n{\n";
+    for (size_t i = fn.params.size(); i < fn.locals.vars.size(); i++) {
+        out << "    int wz_" << fn.locals.vars[i] << " = 0;\n";
+    }
+    for (int t = 0; t < tempCounter; t++) out << "    int wzt_" << t << ";\n";
+    out << body.str();
+    out << "    return 0;\n}\n\n";
+}
+
+void CEmitter::emitStatement(const ASTNode* stmt, int indent) {
+    if (!stmt) return;
+    const string& type = stmt->nodeType;
+    const vector<ASTNode*>& kids = stmt->children;
+    string p = pad(indent);
+
+    if (type == "block") {
+        for (size_t i = 0; i < kids.size(); i++) emitStatement(kids[i], indent);
+    } else if (type == "assign") {
+        out << p << variable(kids[0]) << " = " << expr(kids[1]) << ";\n";
+    } else if (type == "swap") {
+        out << p << "{ int wzt_swap = " << variable(kids[0]) << "; "
+            << variable(kids[0]) << " = " << variable(kids[1]) << "; "
+            << variable(kids[1]) << " = wzt_swap; }\n";
+    } else if (type == "output") {
+        for (size_t i = 0; i < kids.size(); i++) {
+            const ASTNode* item = kids[i];
+            if (item->nodeType == "string") {
+                out << p << "puts(" << cString(leafText(item->children[0])) << ");\n";
+            } else {
+                out << p << "printf(\"%d\\n\", " << expr(item->children[0]) << ");\n";
+            }
+        }
+    } else if (type == "if") {
+        out << p << "if (" << expr(kids[0]) << ") {\n";
+        if (kids.size() > 1) emitStatement(kids[1], indent + 1);
+        if (kids.size() > 2) {
+            out << p << "} else {\n";
+            emitStatement(kids[2], indent + 1);
+        }
+        out << p << "}\n";
+    } else if (type == "while") {
+        out << p << "while (" << expr(kids[0]) << ") {\n";
+        if (kids.size() > 1) emitStatement(kids[1], indent + 1);
+        out << p << "}\n";
+    } else if (type == "repeat") {
+        out << p << "do {\n";
+        for (size_t i = 0; i + 1 < kids.size(); i++) emitStatement(kids[i], indent + 1);
+        out << p << "} while (!(" << expr(kids.back()) << "));\n";
+    } else if (type == "for") {
+        emitStatement(kids[0], indent);
+        out << p << "while (" << expr(kids[1]) << ") {\n";
+        emitStatement(kids[3], indent + 1);
+        emitStatement(kids[2], indent + 1);
+        out << p << "}\n";
+    } else if (type == "loop") {
+        // 'exit' leaves the innermost loop/pool even from inside while or
+        // case, so it is lowered to a goto rather than break
+        int label = labelCounter++;
+        exitLabels.push_back(label);
+        out << p << "for (;;) {\n";
+        for (size_t i = 0; i < kids.size(); i++) emitStatement(kids[i], indent + 1);
+        out << p << "}\n";
+        out << p << "wzl_exit" << label << ":;\n";
+        exitLabels.pop_back();
+    } else if (type == "exit") {
+        if (exitLabels.empty()) {
+            out << p << "return 0;\n";
+        } else {
+            out << p << "goto wzl_exit" << exitLabels.back() << ";\n";
+        }
+    } else if (type == "case") {
+        emitCase(stmt, indent);
+    } else if (type == "read") {
+        emitRead(stmt, indent);
+    } else if (type == "return") {
+        string value = kids.empty() ? "0" : expr(kids[0]);
+        if (current) {
+            out << p << "return " << value << ";\n";
+        } else {
+            // 'return' in the main block ends the program normally
+            out << p << "(void)" << value << ";\n" << p << "return 0;\n";
+        }
+    } else if (type == "<null>") {
+        // Empty statement
+    } else {
+        throw runtime_error("cannot translate statement '" + type + "'");
+    }
+}
+
+void CEmitter::emitCase(const ASTNode* caseNode, int indent) {
+    string p = pad(indent);
+    int t = tempCounter++;
+    string sel = "wzt_" + to_string(t);
+    out << p << sel << " = " << expr(caseNode->children[0]) << ";\n";
+
+    bool first = true;
+    for (size_t i = 1; i < caseNode->children.size(); i++) {
+        const ASTNode* clause = caseNode->children[i];
+        if (clause->nodeType == "otherwise") {
+            out << p << (first ? "{\n" : "} else {\n");
+            emitStatement(clause->children.empty() ? nullptr : clause->children[0], indent + 1);
+            first = false;
+            continue;
+        }
+
+        const ASTNode* label = clause->children[0];
+        string test;
+        if (label->nodeType == "..") {
+            test = sel + " >= " + expr(label->children[0]) + " && " +
+                   sel + " <= " + expr(label->children[1]);
+        } else {
+            test = sel + " == " + expr(label);
+        }
+        out << p << (first ? "if (" : "} else if (") << test << ") {\n";
+        if (clause->children.size() > 1) emitStatement(clause->children[1], indent + 1);
+        first = false;
+    }
+    if (!first) out << p << "}\n";
+}
+
+void CEmitter::emitRead(const ASTNode* read, int indent) {
+    for (size_t i = 0; i < read->children.size(); i++) {
+        const ASTNode* target = read->children[i];
+        const Symbol* sym = info.lookup(current, leafText(target));
+        bool isChar = sym && sym->typeName == "char";
+        out << pad(indent) << variable(target) << " = "
+            << (isChar ? "wzrt_read_char()" : "wzrt_read_int()") << ";\n";
+    }
+}
+
+string CEmitter::variable(const ASTNode* identifier) {
+    string name = leafText(identifier);
+    const Symbol* sym = info.lookup(current, name);
+    if (!sym || sym->kind != SYM_VAR) {
+        throw runtime_error("'" + name + "' is not a variable");
+    }
+    return "wz_" + name;
+}
+
+// Evaluates operands left to right into temporaries when any operand has
+// side effects, since C leaves operand order unspecified: an effect in the
+// first operand must land before a later one reads the state it changed.
+string CEmitter::sequenced(const vector<const ASTNode*>& operands, vector<string>& values) {
+    bool ordered = false;
+    for (size_t i = 0; i < operands.size(); i++) {
+        if (hasEffects(operands[i])) ordered = true;
+    }
+
+    string prefix;
+    for (size_t i = 0; i < operands.size(); i++) {
+        string value = expr(operands[i]);
+        if (ordered && i + 1 < operands.size()) {
+            string temp = "wzt_" + to_string(tempCounter++);
+            prefix += temp + " = " + value + ", ";
+            value = temp;
+        }
+        values.push_back(value);
+    }
+    return prefix;
+}
+
+string CEmitter::expr(const ASTNode* node) {
+    if (!node) throw runtime_error("missing expression");
+    const string& type = node->nodeType;
+    const vector<ASTNode*>& kids = node->children;
+
+    if (type == "<integer>") return cInt(integerValue(leafText(node)));
+    if (type == "<char>") return cInt(charValue(leafText(node)));
+    if (type == "true") return "1";
+    if (type == "eof") return "wzrt_eof()";
+
+    if (type == "<identifier>") {
+        string name = leafText(node);
+        const Symbol* sym = info.lookup(current, name);
+        if (!sym || sym->kind == SYM_FUNCTION) {
+            throw runtime_error("'" + name + "' cannot be used as a value");
+        }
+        if (sym->kind == SYM_VAR) return "wz_" + name;
+        return cInt(sym->value);
+    }
+
+    if (type == "call") {
+        string name = leafText(kids[0]);
+        const FunctionInfo* fn = info.findFunction(name);
+        if (!fn) throw runtime_error("call to undefined function '" + name + "'");
+        if (fn->params.size() != kids.size() - 1) {
+            throw runtime_error("wrong number of arguments to '" + name + "'");
+        }
+        vector<const ASTNode*> args(kids.begin() + 1, kids.end());
+        vector<string> values;
+        string prefix = sequenced(args, values);
+        string call = "wzf_" + name + "(";
+        for (size_t i = 0; i < values.size(); i++) call += (i ? ", " : "") + values[i];
+        call += ")";
+        return prefix.empty() ? call : "(" + prefix + call + ")";
+    }
+
+    if (kids.size() == 1) {
+        string a = expr(kids[0]);
+        if (type == "-") return "WZ_NEG(" + a + ")";
+        if (type == "not") return "(!" + a + ")";
+        if (type == "succ") return "WZ_ADD(" + a + ", 1)";
+        if (type == "pred") return "WZ_SUB(" + a + ", 1)";
+        if (type == "chr" || type == "ord") return a;
+    }
+
+    if (kids.size() == 2) {
+        // 'and'/'or' short-circuit, which already sequences the operands
+        if (type == "and") return "(" + expr(kids[0]) + " && " + expr(kids[1]) + ")";
+        if (type == "or") return "(" + expr(kids[0]) + " || " + expr(kids[1]) + ")";
+
+        vector<const ASTNode*> operands(kids.begin(), kids.end());
+        vector<string> v;
+        string prefix = sequenced(operands, v);
+        string result;
+        if (type == "+") result = "WZ_ADD(" + v[0] + ", " + v[1] + ")";
+        else if (type == "-") result = "WZ_SUB(" + v[0] + ", " + v[1] + ")";
+        else if (type == "*") result = "WZ_MUL(" + v[0] + ", " + v[1] + ")";
+        else if (type == "/") result = "wzrt_div(" + v[0] + ", " + v[1] + ")";
+        else if (type == "mod") result = "wzrt_mod(" + v[0] + ", " + v[1] + ")";
+        else if (type == "=") result = "(" + v[0] + " == " + v[1] + ")";
+        else if (type == "<>") result = "(" + v[0] + " != " + v[1] + ")";
+        else if (type == "<" || type == "<=" || type == ">" || type == ">=") {
+            result = "(" + v[0] + " " + type + " " + v[1] + ")";
+        } else {
+            throw runtime_error("cannot translate operator '" + type + "'");
+        }
+        return prefix.empty() ? result : "(" + prefix + result + ")";
+    }
+
+    throw runtime_error("cannot translate expression '" + type + "'");
+}
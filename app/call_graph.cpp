@@ -0,0 +1,226 @@
+#include "call_graph.h"
+#include "ast_visitor.h"
+#include "symbols.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+
+using namespace std;
+
+// Frontiers smaller than this are expanded on the calling thread
+static const size_t PARALLEL_FRONTIER = 4096;
+
+// Gathers the names called anywhere below the starting node
+class CallCollector : public AstVisitor<CallCollector> {
+public:
+    explicit CallCollector(vector<string>& result) : names(result) {}
+
+    VisitAction pre(const ASTNode* node, int) {
+        if (node->kind == NK_CALL) names.push_back(leafText(node->children[0]));
+        return VISIT_CHILDREN;
+    }
+
+private:
+    vector<string>& names;
+};
+
+// Distinct callee numbers of the calls under node, plus unresolved names
+static void resolveCalls(const ASTNode* node, const unordered_map<string, uint32_t>& index,
+                         vector<uint32_t>& callees, vector<string>& unresolved) {
+    vector<string> names;
+    CallCollector(names).walk(node);
+    for (size_t i = 0; i < names.size(); i++) {
+        unordered_map<string, uint32_t>::const_iterator it = index.find(names[i]);
+        if (it != index.end()) {
+            callees.push_back(it->second);
+        } else {
+            unresolved.push_back(names[i]);
+        }
+    }
+    sort(callees.begin(), callees.end());
+    callees.erase(unique(callees.begin(), callees.end()), callees.end());
+}
+
+CallGraph buildCallGraph(const ASTNode* program, unsigned threads) {
+    CallGraph graph;
+    const ASTNode* subprogs = findSubprogs(program);
+    if (subprogs) graph.fcns.assign(subprogs->children.begin(), subprogs->children.end());
+    size_t count = graph.fcns.size();
+
+    unordered_map<string, uint32_t> index;
+    graph.names.resize(count);
+    for (size_t f = 0; f < count; f++) {
+        graph.names[f] = leafText(graph.fcns[f]->children[0]);
+        index[graph.names[f]] = (uint32_t)f;
+    }
+
+    // One slot per function, filled by whichever worker takes it
+    vector<vector<uint32_t> > callees(count);
+    vector<vector<string> > unresolved(count + 1);
+    parallelForFunctions(program, threads, [&](const ASTNode* fcn, size_t f) {
+        TraceSpan span("resolveCalls", "semantic");
+        span.setDetail(graph.names[f]);
+        resolveCalls(fcn, index, callees[f], unresolved[f]);
+    });
+    for (size_t i = 0; i < program->children.size(); i++) {
+        if (program->children[i]->kind == NK_BLOCK) {
+            resolveCalls(program->children[i], index, graph.roots, unresolved[count]);
+        }
+    }
+
+    graph.calleeStart.resize(count + 1);
+    graph.calleeStart[0] = 0;
+    for (size_t f = 0; f < count; f++) graph.calleeStart[f + 1] = graph.calleeStart[f] + (uint32_t)callees[f].size();
+    graph.callees.reserve(graph.calleeStart[count]);
+    for (size_t f = 0; f < count; f++) graph.callees.insert(graph.callees.end(), callees[f].begin(), callees[f].end());
+
+    for (size_t f = 0; f <= count; f++) {
+        graph.unresolved.insert(graph.unresolved.end(), unresolved[f].begin(), unresolved[f].end());
+    }
+    sort(graph.unresolved.begin(), graph.unresolved.end());
+    graph.unresolved.erase(unique(graph.unresolved.begin(), graph.unresolved.end()), graph.unresolved.end());
+    return graph;
+}
+
+// Appends the unvisited callees of frontier[begin, end) to next, claiming
+// each function with an atomic exchange so only one thread queues it
+static void expandFrontier(const CallGraph& graph, const vector<uint32_t>& frontier, size_t begin, size_t end,
+                           atomic<uint8_t>* seen, vector<uint32_t>& next) {
+    for (size_t i = begin; i < end; i++) {
+        uint32_t f = frontier[i];
+        for (uint32_t e = graph.calleeStart[f]; e < graph.calleeStart[f + 1]; e++) {
+            uint32_t callee = graph.callees[e];
+            if (!seen[callee].load(memory_order_relaxed) && !seen[callee].exchange(1)) next.push_back(callee);
+        }
+    }
+}
+
+vector<char> reachableFunctions(const CallGraph& graph, unsigned threads) {
+    size_t count = graph.functionCount();
+    unique_ptr<atomic<uint8_t>[]> seen(new atomic<uint8_t>[count]);
+    for (size_t f = 0; f < count; f++) seen[f].store(0);
+
+    vector<uint32_t> frontier;
+    for (size_t i = 0; i < graph.roots.size(); i++) {
+        if (!seen[graph.roots[i]].exchange(1)) frontier.push_back(graph.roots[i]);
+    }
+
+    // Level by level; a wide level is cut into one slice per worker
+    while (!frontier.empty()) {
+        vector<uint32_t> next;
+        if (threads <= 1 || frontier.size() < PARALLEL_FRONTIER) {
+            expandFrontier(graph, frontier, 0, frontier.size(), seen.get(), next);
+        } else {
+            vector<vector<uint32_t> > slices(threads);
+            vector<thread> pool;
+            size_t step = (frontier.size() + threads - 1) / threads;
+            for (unsigned t = 0; t < threads; t++) {
+                size_t begin = min(frontier.size(), t * step), end = min(frontier.size(), begin + step);
+                pool.push_back(thread(expandFrontier, cref(graph), cref(frontier), begin, end, seen.get(),
+                                      ref(slices[t])));
+            }
+            for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+            for (unsigned t = 0; t < threads; t++) next.insert(next.end(), slices[t].begin(), slices[t].end());
+        }
+        frontier.swap(next);
+    }
+
+    vector<char> reachable(count);
+    for (size_t f = 0; f < count; f++) reachable[f] = seen[f].load() != 0;
+    return reachable;
+}
+
+// Tarjan's algorithm with an explicit stack, so long call chains cannot
+// overflow the C++ one
+vector<vector<uint32_t> > recursiveComponents(const CallGraph& graph) {
+    const uint32_t UNVISITED = 0xffffffffu;
+    size_t count = graph.functionCount();
+    vector<uint32_t> order(count, UNVISITED), low(count), edge(count);
+    vector<char> onStack(count, 0);
+    vector<uint32_t> stack, path;
+    uint32_t visited = 0;
+    vector<vector<uint32_t> > components;
+
+    for (uint32_t start = 0; start < count; start++) {
+        if (order[start] != UNVISITED) continue;
+        path.push_back(start);
+        while (!path.empty()) {
+            uint32_t f = path.back();
+            if (order[f] == UNVISITED) {
+                order[f] = low[f] = visited++;
+                edge[f] = graph.calleeStart[f];
+                stack.push_back(f);
+                onStack[f] = 1;
+            }
+            if (edge[f] < graph.calleeStart[f + 1]) {
+                uint32_t callee = graph.callees[edge[f]++];
+                if (order[callee] == UNVISITED) {
+                    path.push_back(callee);
+                } else if (onStack[callee]) {
+                    low[f] = min(low[f], order[callee]);
+                }
+                continue;
+            }
+
+            // All callees done: f closes a component if nothing below reached above it
+            path.pop_back();
+            if (!path.empty()) low[path.back()] = min(low[path.back()], low[f]);
+            if (low[f] != order[f]) continue;
+            vector<uint32_t> members;
+            uint32_t member;
+            do {
+                member = stack.back();
+                stack.pop_back();
+                onStack[member] = 0;
+                members.push_back(member);
+            } while (member != f);
+
+            bool selfCall = false;
+            for (uint32_t e = graph.calleeStart[f]; e < graph.calleeStart[f + 1]; e++) {
+                if (graph.callees[e] == f) selfCall = true;
+            }
+            if (members.size() > 1 || selfCall) {
+                sort(members.begin(), members.end());
+                components.push_back(members);
+            }
+        }
+    }
+    sort(components.begin(), components.end());
+    return components;
+}
+
+ASTNode* pruneUnreachable(const ASTNode* program, const CallGraph& graph, const vector<char>& reachable) {
+    ASTNode* pruned = new ASTNode(program->nodeType, program->kind);
+    for (size_t i = 0; i < program->children.size(); i++) {
+        ASTNode* child = program->children[i];
+        if (child->kind == NK_SUBPROGS) {
+            ASTNode* kept = new ASTNode(child->nodeType, child->kind);
+            for (size_t f = 0; f < graph.functionCount(); f++) {
+                if (reachable[f]) kept->addChild(const_cast<ASTNode*>(graph.fcns[f]));
+            }
+            child = kept;
+        }
+        pruned->addChild(child);
+    }
+    return pruned;
+}
+
+void printCallGraphReport(const CallGraph& graph, const vector<char>& reachable,
+                          const vector<vector<uint32_t> >& recursive, ostream& out) {
+    size_t reached = count(reachable.begin(), reachable.end(), 1);
+    out << "functions: " << graph.functionCount() << ", call edges: " << graph.edgeCount()
+        << ", called from main: " << graph.roots.size() << "\n";
+    out << "reachable: " << reached << ", unreachable: " << graph.functionCount() - reached << "\n";
+    for (size_t c = 0; c < recursive.size(); c++) {
+        out << "recursive:";
+        for (size_t i = 0; i < recursive[c].size(); i++) out << " " << graph.names[recursive[c][i]];
+        out << "\n";
+    }
+    for (size_t f = 0; f < graph.functionCount(); f++) {
+        if (!reachable[f]) out << "unreachable: " << graph.names[f] << "\n";
+    }
+    for (size_t i = 0; i < graph.unresolved.size(); i++) out << "unresolved: " << graph.unresolved[i] << "\n";
+}
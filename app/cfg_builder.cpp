@@ -0,0 +1,655 @@
+#include "cfg_builder.h"
+#include "ast_visitor.h"
+#include "trace.h"
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+const uint32_t FunctionCfg::NONE;
+
+namespace {
+
+const uint32_t NONE = FunctionCfg::NONE;
+
+// Turns (key, value) pairs into CSR form, keeping each key's values in
+// insertion order
+void buildCsr(size_t keys, const vector<uint32_t>& from, const vector<uint32_t>& to,
+              vector<uint32_t>& start, vector<uint32_t>& values) {
+    start.assign(keys + 1, 0);
+    for (size_t i = 0; i < from.size(); i++) start[from[i] + 1]++;
+    for (size_t k = 0; k < keys; k++) start[k + 1] += start[k];
+    values.resize(from.size());
+    vector<uint32_t> fill(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < from.size(); i++) values[fill[from[i]]++] = to[i];
+}
+
+class CfgBuilder {
+public:
+    CfgBuilder(FunctionCfg& result, const vector<string>& vars) : cfg(result) {
+        cfg.vars = vars;
+        for (size_t i = 0; i < vars.size(); i++) varIndex[vars[i]] = (uint32_t)i;
+    }
+
+    void build(const ASTNode* body) {
+        newBlock(); // entry
+        newBlock(); // exit
+        current = 0;
+        lower(body);
+        edge(current, 1);
+
+        size_t blocks = blockCount;
+        buildCsr(blocks, edgeFrom, edgeTo, cfg.succStart, cfg.succ);
+        buildCsr(blocks, edgeTo, edgeFrom, cfg.predStart, cfg.pred);
+
+        // Position of each successor edge in its target's predecessor list,
+        // which is the edge's operand in the target's phis
+        vector<uint32_t> edgeIds(edgeFrom.size()), succEdges, predEdges, scratch;
+        for (size_t i = 0; i < edgeIds.size(); i++) edgeIds[i] = (uint32_t)i;
+        buildCsr(blocks, edgeFrom, edgeIds, scratch, succEdges);
+        buildCsr(blocks, edgeTo, edgeIds, scratch, predEdges);
+        vector<uint32_t> operandOfEdge(edgeIds.size());
+        for (size_t k = 0; k < predEdges.size(); k++) operandOfEdge[predEdges[k]] = (uint32_t)k - scratch[edgeTo[predEdges[k]]];
+        succOperand.resize(succEdges.size());
+        for (size_t e = 0; e < succEdges.size(); e++) succOperand[e] = operandOfEdge[succEdges[e]];
+
+        computeDominators();
+        placePhis();
+        rename();
+    }
+
+private:
+    FunctionCfg& cfg;
+    unordered_map<string, uint32_t> varIndex;
+
+    // Lowering output, one entry per statement instruction
+    size_t blockCount = 0;
+    uint32_t current = 0;
+    vector<uint32_t> edgeFrom, edgeTo;
+    vector<uint32_t> succOperand; // parallel to cfg.succ
+    vector<CfgInstr> body;
+    vector<uint32_t> bodyBlock;
+    vector<uint32_t> useVarStart = vector<uint32_t>(1, 0), useVars;
+    vector<uint32_t> defVarStart = vector<uint32_t>(1, 0), defVars;
+    vector<uint32_t> exitTargets; // innermost loop's successor last
+
+    // Dominator tree and phi placement
+    vector<uint32_t> postorder;   // reachable blocks
+    vector<uint32_t> postNumber;  // NONE if unreachable
+    vector<size_t> climbMark;     // see intersect
+    size_t climbStamp;
+    vector<vector<uint32_t> > blockPhis; // variables needing a phi per block
+
+    uint32_t newBlock() {
+        return (uint32_t)blockCount++;
+    }
+
+    void edge(uint32_t from, uint32_t to) {
+        edgeFrom.push_back(from);
+        edgeTo.push_back(to);
+    }
+
+    // Ends the current block with a jump and continues in target
+    void jumpTo(uint32_t target) {
+        edge(current, target);
+        current = target;
+    }
+
+    void collectUses(const ASTNode* expr) {
+        if (!expr) return;
+        if (expr->kind == NK_IDENTIFIER) {
+            unordered_map<string, uint32_t>::const_iterator it = varIndex.find(leafText(expr));
+            if (it == varIndex.end()) return;
+            // One use per variable and instruction
+            for (size_t i = useVarStart.back(); i < useVars.size(); i++) {
+                if (useVars[i] == it->second) return;
+            }
+            useVars.push_back(it->second);
+            return;
+        }
+        // The callee of a call is a function name
+        size_t first = expr->kind == NK_CALL ? 1 : 0;
+        for (size_t i = first; i < expr->children.size(); i++) collectUses(expr->children[i]);
+    }
+
+    void addDef(const ASTNode* identifier) {
+        unordered_map<string, uint32_t>::const_iterator it = varIndex.find(leafText(identifier));
+        if (it != varIndex.end()) defVars.push_back(it->second);
+    }
+
+    // Call after pushing the instruction's uses and defs
+    void emit(CfgOp op, const ASTNode* node) {
+        CfgInstr instr = {op, node};
+        body.push_back(instr);
+        bodyBlock.push_back(current);
+        useVarStart.push_back((uint32_t)useVars.size());
+        defVarStart.push_back((uint32_t)defVars.size());
+    }
+
+    void lowerAll(const ASTNode* node, size_t from, size_t to) {
+        for (size_t i = from; i < to; i++) lower(node->children[i]);
+    }
+
+    void lower(const ASTNode* stmt) {
+        if (!stmt) return;
+        const vector<ASTNode*>& kids = stmt->children;
+
+        switch (stmt->kind) {
+            case NK_BLOCK:
+                lowerAll(stmt, 0, kids.size());
+                break;
+            case NK_ASSIGN:
+                collectUses(kids[1]);
+                addDef(kids[0]);
+                emit(CFG_ASSIGN, stmt);
+                break;
+            case NK_SWAP:
+                collectUses(kids[0]);
+                collectUses(kids[1]);
+                addDef(kids[0]);
+                addDef(kids[1]);
+                emit(CFG_SWAP, stmt);
+                break;
+            case NK_READ:
+                for (size_t i = 0; i < kids.size(); i++) addDef(kids[i]);
+                emit(CFG_READ, stmt);
+                break;
+            case NK_OUTPUT:
+                for (size_t i = 0; i < kids.size(); i++) {
+                    if (kids[i]->kind == NK_OUTPUT_INTEGER) collectUses(kids[i]->children[0]);
+                }
+                emit(CFG_OUTPUT, stmt);
+                break;
+            case NK_IF: {
+                collectUses(kids[0]);
+                emit(CFG_BRANCH, kids[0]);
+                uint32_t branch = current, thenBlock = newBlock(), elseBlock = newBlock();
+                uint32_t join = kids.size() > 2 ? newBlock() : elseBlock;
+                edge(branch, thenBlock);
+                edge(branch, elseBlock);
+                current = thenBlock;
+                if (kids.size() > 1) lower(kids[1]);
+                edge(current, join);
+                if (kids.size() > 2) {
+                    current = elseBlock;
+                    lower(kids[2]);
+                    edge(current, join);
+                }
+                current = join;
+                break;
+            }
+            case NK_WHILE: {
+                uint32_t header = newBlock(), loopBody = newBlock(), after = newBlock();
+                jumpTo(header);
+                collectUses(kids[0]);
+                emit(CFG_BRANCH, kids[0]);
+                edge(header, loopBody);
+                edge(header, after);
+                current = loopBody;
+                if (kids.size() > 1) lower(kids[1]);
+                edge(current, header);
+                current = after;
+                break;
+            }
+            case NK_REPEAT: {
+                uint32_t loopBody = newBlock(), after = newBlock();
+                jumpTo(loopBody);
+                lowerAll(stmt, 0, kids.size() - 1);
+                collectUses(kids.back());
+                emit(CFG_BRANCH, kids.back());
+                // repeat ... until cond leaves when cond holds
+                edge(current, after);
+                edge(current, loopBody);
+                current = after;
+                break;
+            }
+            case NK_FOR: {
+                lower(kids[0]);
+                uint32_t header = newBlock(), loopBody = newBlock(), after = newBlock();
+                jumpTo(header);
+                collectUses(kids[1]);
+                emit(CFG_BRANCH, kids[1]);
+                edge(header, loopBody);
+                edge(header, after);
+                current = loopBody;
+                lower(kids[3]);
+                lower(kids[2]);
+                edge(current, header);
+                current = after;
+                break;
+            }
+            case NK_LOOP: {
+                uint32_t loopBody = newBlock(), after = newBlock();
+                jumpTo(loopBody);
+                exitTargets.push_back(after);
+                lowerAll(stmt, 0, kids.size());
+                exitTargets.pop_back();
+                edge(current, loopBody);
+                current = after;
+                break;
+            }
+            case NK_EXIT:
+                // Outside any loop, exit ends the function like the interpreter
+                edge(current, exitTargets.empty() ? 1 : exitTargets.back());
+                current = newBlock(); // unreachable
+                break;
+            case NK_RETURN:
+                if (!kids.empty()) collectUses(kids[0]);
+                emit(CFG_RETURN, stmt);
+                edge(current, 1);
+                current = newBlock(); // unreachable
+                break;
+            case NK_CASE: {
+                collectUses(kids[0]);
+                emit(CFG_SWITCH, kids[0]);
+                uint32_t selector = current, after = newBlock();
+                bool otherwise = false;
+                for (size_t i = 1; i < kids.size(); i++) {
+                    const ASTNode* clause = kids[i];
+                    uint32_t target = newBlock();
+                    edge(selector, target);
+                    current = target;
+                    if (clause->kind == NK_OTHERWISE) {
+                        otherwise = true;
+                        if (!clause->children.empty()) lower(clause->children[0]);
+                    } else if (clause->children.size() > 1) {
+                        lower(clause->children[1]);
+                    }
+                    edge(current, after);
+                }
+                if (!otherwise) edge(selector, after);
+                current = after;
+                break;
+            }
+            default:
+                break; // <null>
+        }
+    }
+
+    void computeDominators() {
+        size_t blocks = blockCount;
+        postNumber.assign(blocks, NONE);
+
+        // Iterative depth-first search for the postorder of reachable blocks
+        vector<uint32_t> stack(1, 0), nextSucc(blocks, 0);
+        vector<char> seen(blocks, 0);
+        seen[0] = 1;
+        while (!stack.empty()) {
+            uint32_t b = stack.back();
+            if (nextSucc[b] < cfg.succStart[b + 1] - cfg.succStart[b]) {
+                uint32_t s = cfg.succ[cfg.succStart[b] + nextSucc[b]++];
+                if (!seen[s]) {
+                    seen[s] = 1;
+                    stack.push_back(s);
+                }
+            } else {
+                postNumber[b] = (uint32_t)postorder.size();
+                postorder.push_back(b);
+                stack.pop_back();
+            }
+        }
+
+        // Cooper, Harvey and Kennedy: iterate in reverse postorder until the
+        // immediate dominators settle, intersecting along postorder numbers
+        vector<uint32_t>& idom = cfg.idom;
+        idom.assign(blocks, NONE);
+        idom[0] = 0;
+        climbMark.assign(blocks, 0);
+        climbStamp = 0;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t i = postorder.size() - 1; i-- > 0;) {
+                uint32_t b = postorder[i];
+                uint32_t newIdom = NONE;
+                climbStamp++;
+                for (uint32_t e = cfg.predStart[b]; e < cfg.predStart[b + 1]; e++) {
+                    uint32_t p = cfg.pred[e];
+                    if (idom[p] == NONE) continue;
+                    if (newIdom == NONE) {
+                        newIdom = p;
+                        climbMark[p] = climbStamp;
+                    } else {
+                        newIdom = intersect(p, newIdom);
+                    }
+                }
+                if (idom[b] != newIdom) {
+                    idom[b] = newIdom;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // Blocks walked while intersecting the current block's predecessors are
+    // marked; the running result dominates all of them, so a climb reaching
+    // one can stop there. This keeps joins with many predecessors (the exit
+    // block) from climbing the whole dominator tree once per predecessor.
+    uint32_t intersect(uint32_t a, uint32_t b) {
+        while (a != b) {
+            while (postNumber[a] < postNumber[b]) {
+                if (climbMark[a] == climbStamp) return b;
+                climbMark[a] = climbStamp;
+                a = cfg.idom[a];
+            }
+            while (postNumber[b] < postNumber[a]) {
+                climbMark[b] = climbStamp;
+                b = cfg.idom[b];
+            }
+        }
+        climbMark[a] = climbStamp;
+        return a;
+    }
+
+    void placePhis() {
+        size_t blocks = blockCount;
+        const vector<uint32_t>& idom = cfg.idom;
+
+        // Dominance frontiers, walking up from each predecessor of a join.
+        // A walk stops at a block that already has the join: an earlier
+        // walk went on from there to the join's idom, which keeps the total
+        // work proportional to the frontier sizes
+        vector<vector<uint32_t> > frontier(blocks);
+        for (uint32_t b = 0; b < blocks; b++) {
+            if (idom[b] == NONE || cfg.predStart[b + 1] - cfg.predStart[b] < 2) continue;
+            for (uint32_t e = cfg.predStart[b]; e < cfg.predStart[b + 1]; e++) {
+                uint32_t runner = cfg.pred[e];
+                if (idom[runner] == NONE) continue;
+                while (runner != idom[b]) {
+                    if (!frontier[runner].empty() && frontier[runner].back() == b) break;
+                    frontier[runner].push_back(b);
+                    runner = idom[runner];
+                }
+            }
+        }
+
+        // Blocks defining each variable; every variable is defined on entry
+        size_t varCount = cfg.vars.size();
+        vector<uint32_t> defFrom, defTo;
+        for (size_t i = 0; i < body.size(); i++) {
+            if (idom[bodyBlock[i]] == NONE) continue;
+            for (uint32_t d = defVarStart[i]; d < defVarStart[i + 1]; d++) {
+                defFrom.push_back(defVars[d]);
+                defTo.push_back(bodyBlock[i]);
+            }
+        }
+        vector<uint32_t> siteStart, sites;
+        buildCsr(varCount, defFrom, defTo, siteStart, sites);
+
+        blockPhis.assign(blocks, vector<uint32_t>());
+        vector<uint32_t> hasPhi(blocks, NONE), queued(blocks, NONE), work;
+        for (uint32_t v = 0; v < varCount; v++) {
+            work.clear();
+            work.push_back(0);
+            queued[0] = v;
+            for (uint32_t s = siteStart[v]; s < siteStart[v + 1]; s++) {
+                if (queued[sites[s]] != v) {
+                    queued[sites[s]] = v;
+                    work.push_back(sites[s]);
+                }
+            }
+            while (!work.empty()) {
+                uint32_t b = work.back();
+                work.pop_back();
+                for (size_t f = 0; f < frontier[b].size(); f++) {
+                    uint32_t join = frontier[b][f];
+                    if (hasPhi[join] == v) continue;
+                    hasPhi[join] = v;
+                    blockPhis[join].push_back(v);
+                    if (queued[join] != v) {
+                        queued[join] = v;
+                        work.push_back(join);
+                    }
+                }
+            }
+        }
+    }
+
+    uint32_t newValue(uint32_t var, vector<uint32_t>& versions) {
+        cfg.valueVar.push_back(var);
+        cfg.valueVersion.push_back(++versions[var]);
+        return (uint32_t)cfg.valueVar.size() - 1;
+    }
+
+    void rename() {
+        size_t blocks = blockCount;
+        size_t varCount = cfg.vars.size();
+
+        // Final instruction order: each block's phis, then its statements
+        vector<uint32_t> bodyStart, bodyOrder, bodyIds(body.size());
+        for (size_t i = 0; i < body.size(); i++) bodyIds[i] = (uint32_t)i;
+        buildCsr(blocks, bodyBlock, bodyIds, bodyStart, bodyOrder);
+
+        cfg.instrStart.assign(blocks + 1, 0);
+        cfg.phiCount = 0;
+        for (size_t b = 0; b < blocks; b++) {
+            cfg.instrStart[b + 1] = cfg.instrStart[b] + (uint32_t)(blockPhis[b].size() + bodyStart[b + 1] - bodyStart[b]);
+            cfg.phiCount += blockPhis[b].size();
+        }
+
+        // Lay out instructions with their use/def ranges; values are filled in below
+        size_t total = cfg.instrStart[blocks];
+        cfg.instrs.resize(total);
+        cfg.useStart.assign(total + 1, 0);
+        cfg.defStart.assign(total + 1, 0);
+        vector<uint32_t> source(total, NONE); // body index, or NONE for a phi
+        for (size_t b = 0; b < blocks; b++) {
+            uint32_t at = cfg.instrStart[b];
+            uint32_t preds = cfg.predStart[b + 1] - cfg.predStart[b];
+            for (size_t p = 0; p < blockPhis[b].size(); p++, at++) {
+                CfgInstr phi = {CFG_PHI, nullptr};
+                cfg.instrs[at] = phi;
+                cfg.useStart[at + 1] = preds;
+                cfg.defStart[at + 1] = 1;
+            }
+            for (uint32_t k = bodyStart[b]; k < bodyStart[b + 1]; k++, at++) {
+                uint32_t i = bodyOrder[k];
+                cfg.instrs[at] = body[i];
+                source[at] = i;
+                cfg.useStart[at + 1] = useVarStart[i + 1] - useVarStart[i];
+                cfg.defStart[at + 1] = defVarStart[i + 1] - defVarStart[i];
+            }
+        }
+        for (size_t i = 0; i < total; i++) {
+            cfg.useStart[i + 1] += cfg.useStart[i];
+            cfg.defStart[i + 1] += cfg.defStart[i];
+        }
+        cfg.uses.assign(cfg.useStart[total], NONE);
+        cfg.defs.assign(cfg.defStart[total], NONE);
+
+        // Entry values
+        vector<uint32_t> versions(varCount, 0);
+        for (uint32_t v = 0; v < varCount; v++) {
+            cfg.valueVar.push_back(v);
+            cfg.valueVersion.push_back(0);
+        }
+
+        // Dominator tree children
+        vector<uint32_t> treeFrom, treeTo, childStart, children;
+        for (uint32_t b = 1; b < blocks; b++) {
+            if (cfg.idom[b] == NONE) continue;
+            treeFrom.push_back(cfg.idom[b]);
+            treeTo.push_back(b);
+        }
+        buildCsr(blocks, treeFrom, treeTo, childStart, children);
+
+        // Walk the dominator tree with one value stack per variable; trail
+        // records pushes so leaving a block can pop them
+        vector<uint32_t> top(varCount);
+        for (uint32_t v = 0; v < varCount; v++) top[v] = v;
+        vector<pair<uint32_t, uint32_t> > trail; // (variable, previous top)
+        struct Visit {
+            uint32_t block;
+            uint32_t nextChild;
+            size_t trailSize;
+        };
+        vector<Visit> stack;
+        Visit root = {0, childStart[0], 0};
+        stack.push_back(root);
+        enterBlock(0, top, trail, versions, source);
+
+        while (!stack.empty()) {
+            Visit& visit = stack.back();
+            if (visit.nextChild < childStart[visit.block + 1]) {
+                uint32_t child = children[visit.nextChild++];
+                Visit next = {child, childStart[child], trail.size()};
+                stack.push_back(next);
+                enterBlock(child, top, trail, versions, source);
+                continue;
+            }
+            while (trail.size() > visit.trailSize) {
+                top[trail.back().first] = trail.back().second;
+                trail.pop_back();
+            }
+            stack.pop_back();
+        }
+    }
+
+    void enterBlock(uint32_t b, vector<uint32_t>& top, vector<pair<uint32_t, uint32_t> >& trail,
+                    vector<uint32_t>& versions, const vector<uint32_t>& source) {
+        uint32_t at = cfg.instrStart[b];
+        for (size_t p = 0; p < blockPhis[b].size(); p++, at++) {
+            uint32_t var = blockPhis[b][p];
+            trail.push_back(make_pair(var, top[var]));
+            top[var] = newValue(var, versions);
+            cfg.defs[cfg.defStart[at]] = top[var];
+        }
+        for (; at < cfg.instrStart[b + 1]; at++) {
+            uint32_t i = source[at];
+            // Every use reads the value from before the instruction
+            for (uint32_t k = 0; k < useVarStart[i + 1] - useVarStart[i]; k++) {
+                cfg.uses[cfg.useStart[at] + k] = top[useVars[useVarStart[i] + k]];
+            }
+            for (uint32_t k = 0; k < defVarStart[i + 1] - defVarStart[i]; k++) {
+                uint32_t var = defVars[defVarStart[i] + k];
+                trail.push_back(make_pair(var, top[var]));
+                top[var] = newValue(var, versions);
+                cfg.defs[cfg.defStart[at] + k] = top[var];
+            }
+        }
+
+        // Fill this block's operand of every phi in its successors
+        for (uint32_t e = cfg.succStart[b]; e < cfg.succStart[b + 1]; e++) {
+            uint32_t s = cfg.succ[e];
+            for (size_t p = 0; p < blockPhis[s].size(); p++) {
+                uint32_t phi = cfg.instrStart[s] + (uint32_t)p;
+                cfg.uses[cfg.useStart[phi] + succOperand[e]] = top[blockPhis[s][p]];
+            }
+        }
+    }
+};
+
+// Globals named inside any function; a call may change them
+unordered_set<string> globalsUsedByFunctions(const ProgramInfo& info) {
+    struct Collector : AstVisitor<Collector> {
+        const ProgramInfo& info;
+        const FunctionInfo* fn;
+        unordered_set<string>& names;
+        Collector(const ProgramInfo& i, const FunctionInfo* f, unordered_set<string>& n)
+            : info(i), fn(f), names(n) {}
+        VisitAction pre(const ASTNode* node, int) {
+            if (node->kind != NK_IDENTIFIER) return VISIT_CHILDREN;
+            string name = leafText(node);
+            const Symbol* sym = fn->locals.find(name) ? nullptr : info.globals.find(name);
+            if (sym && sym->kind == SYM_VAR) names.insert(name);
+            return SKIP_CHILDREN;
+        }
+    };
+    unordered_set<string> names;
+    for (size_t i = 0; i < info.functions.size(); i++) {
+        const FunctionInfo& fn = info.functions[i];
+        Collector(info, &fn, names).walk(fn.node->children[6]);
+    }
+    return names;
+}
+
+} // namespace
+
+FunctionCfg buildCfg(const string& name, const ASTNode* body, const vector<string>& vars) {
+    FunctionCfg cfg;
+    cfg.name = name;
+    CfgBuilder(cfg, vars).build(body);
+    return cfg;
+}
+
+vector<FunctionCfg> buildProgramCfgs(const ASTNode* program, const ProgramInfo& info, unsigned threads) {
+    TraceSpan span("cfg", "semantic");
+    vector<FunctionCfg> cfgs(info.functions.size() + 1);
+    parallelForFunctions(program, threads, [&](const ASTNode* fcn, size_t index) {
+        const FunctionInfo& fn = info.functions[index];
+        TraceSpan span("buildCfg", "semantic");
+        span.setDetail(fn.name);
+        cfgs[index] = buildCfg(fn.name, fcn->children[6], fn.locals.vars);
+    });
+
+    unordered_set<string> shared = globalsUsedByFunctions(info);
+    vector<string> mainVars;
+    for (size_t i = 0; i < info.globals.vars.size(); i++) {
+        if (!shared.count(info.globals.vars[i])) mainVars.push_back(info.globals.vars[i]);
+    }
+    cfgs.back() = buildCfg(info.name, program->children[5], mainVars);
+    return cfgs;
+}
+
+static const char* opName(CfgOp op) {
+    switch (op) {
+        case CFG_PHI: return "phi";
+        case CFG_ASSIGN: return "assign";
+        case CFG_SWAP: return "swap";
+        case CFG_READ: return "read";
+        case CFG_OUTPUT: return "output";
+        case CFG_BRANCH: return "branch";
+        case CFG_SWITCH: return "switch";
+        case CFG_RETURN: return "return";
+    }
+    return "?";
+}
+
+static void printValue(const FunctionCfg& cfg, uint32_t value, ostream& out) {
+    if (value == FunctionCfg::NONE) {
+        out << "?";
+        return;
+    }
+    out << cfg.vars[cfg.valueVar[value]] << "." << cfg.valueVersion[value];
+}
+
+static void printBlockList(const char* label, const vector<uint32_t>& start, const vector<uint32_t>& list,
+                           uint32_t b, ostream& out) {
+    if (start[b] == start[b + 1]) return;
+    out << " " << label;
+    for (uint32_t e = start[b]; e < start[b + 1]; e++) out << " b" << list[e];
+}
+
+void printCfg(const FunctionCfg& cfg, ostream& out) {
+    size_t edges = cfg.succ.size();
+    out << cfg.name << ": " << cfg.blockCount() << " blocks, " << edges << " edges, "
+        << cfg.instrs.size() - cfg.phiCount << " instructions, " << cfg.phiCount << " phis, "
+        << cfg.valueVar.size() << " values\n";
+
+    for (uint32_t b = 0; b < cfg.blockCount(); b++) {
+        if (cfg.idom[b] == FunctionCfg::NONE) continue; // unreachable
+        out << "  b" << b;
+        if (b == 0) out << " entry";
+        if (b == 1) out << " exit";
+        if (b != 0) out << " idom b" << cfg.idom[b];
+        printBlockList("<-", cfg.predStart, cfg.pred, b, out);
+        printBlockList("->", cfg.succStart, cfg.succ, b, out);
+        out << "\n";
+
+        for (uint32_t i = cfg.instrStart[b]; i < cfg.instrStart[b + 1]; i++) {
+            out << "    ";
+            for (uint32_t d = cfg.defStart[i]; d < cfg.defStart[i + 1]; d++) {
+                if (d != cfg.defStart[i]) out << ", ";
+                printValue(cfg, cfg.defs[d], out);
+            }
+            if (cfg.defStart[i] != cfg.defStart[i + 1]) out << " = ";
+            out << opName(cfg.instrs[i].op);
+            for (uint32_t u = cfg.useStart[i]; u < cfg.useStart[i + 1]; u++) {
+                out << (u == cfg.useStart[i] ? " " : ", ");
+                printValue(cfg, cfg.uses[u], out);
+            }
+            out << "\n";
+        }
+    }
+}
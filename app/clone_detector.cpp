@@ -0,0 +1,326 @@
+#include "clone_detector.h"
+#include "ast_visitor.h"
+#include "source_files.h"
+#include "parser.h"
+#include "node_arena.h"
+#include "symbols.h"
+#include "trace.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace {
+
+uint64_t mix(uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    return h ^ (h >> 31);
+}
+
+// Fingerprints every subtree bottom-up and keeps those of at least
+// minSize nodes. Nodes are numbered in preorder, the order Locator counts
+// them in.
+class Fingerprinter : public AstVisitor<Fingerprinter> {
+public:
+    Fingerprinter(uint32_t file, size_t minSize, vector<CloneDetector::Record>& result)
+        : fileIndex(file), minimum(minSize), records(result), nextId(0) {}
+
+    VisitAction pre(const ASTNode* node, int) {
+        hash<string> text;
+        Frame frame = {mix(text(node->nodeType) ^ mix(text(node->value) + 1)), 1, nextId++, orphans.size()};
+        frames.push_back(frame);
+        return VISIT_CHILDREN;
+    }
+
+    void post(const ASTNode* node, int) {
+        Frame frame = frames.back();
+        frames.pop_back();
+        uint64_t fingerprint = frame.hash ? frame.hash : 1; // 0 means no parent
+        if (!frames.empty()) {
+            frames.back().hash = mix(frames.back().hash ^ fingerprint);
+            frames.back().size += frame.size;
+        }
+        // Kept subtrees below this node that have no parent yet are its
+        // children: anything deeper was claimed by a kept node in between
+        for (size_t i = frame.orphanMark; i < orphans.size(); i++) records[orphans[i]].site.parent = fingerprint;
+        orphans.resize(frame.orphanMark);
+        if (frame.size < minimum || node->kind == NK_TEXT) return;
+        CloneDetector::Record record = {fingerprint, frame.size, node->kind, {fileIndex, frame.id, 0}};
+        orphans.push_back(records.size());
+        records.push_back(record);
+    }
+
+private:
+    struct Frame {
+        uint64_t hash;
+        uint32_t size;
+        uint32_t id;
+        size_t orphanMark;
+    };
+
+    uint32_t fileIndex;
+    size_t minimum;
+    vector<CloneDetector::Record>& records;
+    vector<Frame> frames;
+    vector<size_t> orphans; // records whose parent is still open
+    uint32_t nextId;
+};
+
+// Names the nodes with the given preorder numbers by their path from the
+// root, as -query prints them, adding the enclosing function
+class Locator : public AstVisitor<Locator> {
+public:
+    Locator(const vector<uint32_t>& wanted, vector<string>& result)
+        : want(wanted), paths(result), id(0), next(0) {
+        paths.resize(want.size());
+    }
+
+    VisitAction pre(const ASTNode* node, int) {
+        lengths.push_back(path.size());
+        if (positions.empty()) {
+            path = node->nodeType;
+        } else {
+            path += "/" + node->nodeType + "[" + to_string(positions.back()++) + "]";
+        }
+        positions.push_back(0);
+        if (node->kind == NK_FCN) functions.push_back(leafText(node->children[0]));
+        if (next < want.size() && want[next] == id) {
+            paths[next++] = functions.empty() ? path : path + " in " + functions.back();
+        }
+        id++;
+        return next < want.size() ? VISIT_CHILDREN : SKIP_CHILDREN;
+    }
+
+    void post(const ASTNode* node, int) {
+        positions.pop_back();
+        path.resize(lengths.back());
+        lengths.pop_back();
+        if (node->kind == NK_FCN) functions.pop_back();
+    }
+
+private:
+    const vector<uint32_t>& want;
+    vector<string>& paths;
+    uint32_t id;
+    size_t next;
+    string path;
+    vector<size_t> lengths;   // of path before each open node
+    vector<size_t> positions; // next child index of each open node
+    vector<string> functions;
+};
+
+// Parses into the active arena; null with the reason in error on failure
+ASTNode* parseFile(const string& path, string& source, string& error) {
+    try {
+        if (!readSourceFile(path, source)) {
+            error = "cannot read " + path;
+            return nullptr;
+        }
+        Parser parser(source);
+        ASTNode* ast = parser.parseProgram();
+        if (!ast) error = "parse error";
+        return ast;
+    } catch (const exception& e) {
+        error = e.what();
+        return nullptr;
+    }
+}
+
+// Calls fn(i) for i in [0, count) on up to threads workers
+template <class Fn>
+void forEachIndex(size_t count, unsigned threads, Fn fn) {
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) fn(i);
+    };
+    vector<thread> pool;
+    for (unsigned t = 1; t < threads && t < count; t++) pool.push_back(thread(worker));
+    worker();
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+}
+
+bool siteBefore(const CloneSite& a, const CloneSite& b) {
+    return a.file != b.file ? a.file < b.file : a.node < b.node;
+}
+
+}
+
+CloneDetector::CloneDetector(const vector<string>& corpus, size_t minSize, unsigned threadCount)
+    : files(corpus), minimum(minSize < 2 ? 2 : minSize), threads(threadCount ? threadCount : 1),
+      shards(new Shard[SHARDS]), failures(corpus.size()), indexed(0) {
+    if (files.size() > 0xffffffffu) throw runtime_error("too many files");
+}
+
+void CloneDetector::insert(vector<Record>& records) {
+    // One lock per shard touched rather than one per subtree
+    sort(records.begin(), records.end(), [](const Record& a, const Record& b) {
+        return a.fingerprint >> 58 < b.fingerprint >> 58;
+    });
+    size_t i = 0;
+    while (i < records.size()) {
+        Shard& shard = shardOf(shards.get(), records[i].fingerprint);
+        lock_guard<mutex> held(shard.lock);
+        for (; i < records.size() && &shardOf(shards.get(), records[i].fingerprint) == &shard; i++) {
+            const Record& r = records[i];
+            Entry entry = {1, r.size, r.kind, r.site};
+            pair<unordered_map<uint64_t, Entry>::iterator, bool> slot = shard.entries.insert(make_pair(r.fingerprint, entry));
+            if (slot.second) continue;
+            slot.first->second.count++;
+            shard.copies.push_back(make_pair(r.fingerprint, r.site));
+        }
+    }
+}
+
+void CloneDetector::indexFiles(atomic<size_t>* next, size_t* count) {
+    Tracer::nameThread("clone worker");
+    NodeArena arena;
+    string source;
+    vector<Record> records;
+    for (size_t i = next->fetch_add(1); i < files.size(); i = next->fetch_add(1)) {
+        Tracer::FileScope traced(files[i]);
+        records.clear();
+        {
+            NodeArena::Scope scope(arena);
+            ASTNode* ast;
+            {
+                TraceSpan span("parse", "parse");
+                ast = parseFile(files[i], source, failures[i]);
+            }
+            if (ast) {
+                TraceSpan span("fingerprint", "clones");
+                Fingerprinter((uint32_t)i, minimum, records).walk(ast);
+            }
+        }
+        arena.reset();
+        TraceSpan span("index", "clones");
+        *count += records.size();
+        insert(records);
+    }
+}
+
+void CloneDetector::run() {
+    atomic<size_t> next(0);
+    unsigned count = (unsigned)min((size_t)threads, files.size());
+    if (count == 0) return;
+    vector<size_t> counts(count, 0);
+    vector<thread> pool;
+    for (unsigned t = 1; t < count; t++) {
+        pool.push_back(thread(&CloneDetector::indexFiles, this, &next, &counts[t]));
+    }
+    indexFiles(&next, &counts[0]);
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+    for (unsigned t = 0; t < count; t++) indexed += counts[t];
+
+    // Copies in fingerprint order, so a group's are one range
+    for (size_t s = 0; s < SHARDS; s++) {
+        vector<pair<uint64_t, CloneSite> >& copies = shards[s].copies;
+        sort(copies.begin(), copies.end(), [](const pair<uint64_t, CloneSite>& a, const pair<uint64_t, CloneSite>& b) {
+            return a.first != b.first ? a.first < b.first : siteBefore(a.second, b.second);
+        });
+    }
+}
+
+const CloneDetector::Entry* CloneDetector::find(uint64_t fingerprint) const {
+    const Shard& shard = shardOf(shards.get(), fingerprint);
+    unordered_map<uint64_t, Entry>::const_iterator it = shard.entries.find(fingerprint);
+    return it == shard.entries.end() ? nullptr : &it->second;
+}
+
+size_t CloneDetector::uniqueFingerprints() const {
+    size_t total = 0;
+    for (size_t s = 0; s < SHARDS; s++) total += shards[s].entries.size();
+    return total;
+}
+
+vector<CloneGroup> CloneDetector::groups() const {
+    vector<CloneGroup> result;
+    for (size_t s = 0; s < SHARDS; s++) {
+        const Shard& shard = shards[s];
+        for (unordered_map<uint64_t, Entry>::const_iterator it = shard.entries.begin(); it != shard.entries.end(); ++it) {
+            const Entry& entry = it->second;
+            if (entry.count < 2) continue;
+            CloneGroup group;
+            group.fingerprint = it->first;
+            group.kind = entry.kind;
+            group.size = entry.size;
+            group.copies.push_back(entry.first);
+            pair<uint64_t, CloneSite> key(it->first, CloneSite());
+            vector<pair<uint64_t, CloneSite> >::const_iterator copy = lower_bound(
+                shard.copies.begin(), shard.copies.end(), key,
+                [](const pair<uint64_t, CloneSite>& a, const pair<uint64_t, CloneSite>& b) { return a.first < b.first; });
+            for (; copy != shard.copies.end() && copy->first == it->first; ++copy) group.copies.push_back(copy->second);
+
+            // Reported through the enclosing clone if every copy has one
+            bool maximal = false;
+            for (size_t i = 0; i < group.copies.size() && !maximal; i++) {
+                const Entry* parent = group.copies[i].parent ? find(group.copies[i].parent) : nullptr;
+                maximal = !parent || parent->count < 2;
+            }
+            if (!maximal) continue;
+            sort(group.copies.begin(), group.copies.end(), siteBefore);
+            result.push_back(group);
+        }
+    }
+    sort(result.begin(), result.end(), [](const CloneGroup& a, const CloneGroup& b) {
+        if (a.size != b.size) return a.size > b.size;
+        return siteBefore(a.copies[0], b.copies[0]);
+    });
+    return result;
+}
+
+size_t CloneDetector::report(ostream& out) {
+    vector<CloneGroup> found = groups();
+
+    // Paths are found by parsing each file with a copy once more
+    vector<vector<uint32_t> > wanted(files.size());
+    for (size_t g = 0; g < found.size(); g++) {
+        for (size_t i = 0; i < found[g].copies.size(); i++) wanted[found[g].copies[i].file].push_back(found[g].copies[i].node);
+    }
+    vector<uint32_t> located;
+    for (size_t f = 0; f < files.size(); f++) {
+        if (wanted[f].empty()) continue;
+        sort(wanted[f].begin(), wanted[f].end());
+        wanted[f].erase(unique(wanted[f].begin(), wanted[f].end()), wanted[f].end());
+        located.push_back((uint32_t)f);
+    }
+    vector<vector<string> > paths(files.size());
+    forEachIndex(located.size(), threads, [&](size_t i) {
+        uint32_t f = located[i];
+        NodeArena arena;
+        NodeArena::Scope scope(arena);
+        string source, error;
+        ASTNode* ast = parseFile(files[f], source, error);
+        if (ast) Locator(wanted[f], paths[f]).walk(ast);
+        // The file changed since it was indexed
+        paths[f].resize(wanted[f].size());
+        for (size_t j = 0; j < paths[f].size(); j++) {
+            if (paths[f][j].empty()) paths[f][j] = "node " + to_string(wanted[f][j]);
+        }
+    });
+
+    for (size_t g = 0; g < found.size(); g++) {
+        const CloneGroup& group = found[g];
+        out << "clone group " << g + 1 << ": " << group.copies.size() << " copies of a " << group.size << "-node "
+            << nodeKindName(group.kind) << "\n";
+        for (size_t i = 0; i < group.copies.size(); i++) {
+            const CloneSite& site = group.copies[i];
+            const vector<uint32_t>& nodes = wanted[site.file];
+            size_t at = lower_bound(nodes.begin(), nodes.end(), site.node) - nodes.begin();
+            out << "  " << files[site.file] << ": " << paths[site.file][at] << "\n";
+        }
+    }
+    size_t skipped = 0;
+    for (size_t f = 0; f < files.size(); f++) {
+        if (failures[f].empty()) continue;
+        out << "skipped " << files[f] << ": " << failures[f] << "\n";
+        skipped++;
+    }
+    out << "files: " << files.size() << " (" << skipped << " skipped), subtrees indexed: " << indexed
+        << ", unique fingerprints: " << uniqueFingerprints() << ", clone groups: " << found.size() << endl;
+    return found.size();
+}
@@ -0,0 +1,176 @@
+#include "golden_verifier.h"
+#include "source_files.h"
+#include "parser.h"
+#include "node_arena.h"
+#include "trace.h"
+#include "nary_chains.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <sys/stat.h>
+
+using namespace std;
+
+static bool readWholeFile(const string& path, string& contents) {
+    ifstream file(path.c_str(), ios::in | ios::binary);
+    if (!file.is_open()) return false;
+    ostringstream os;
+    os << file.rdbuf();
+    contents = os.str();
+    return true;
+}
+
+static vector<string> splitLines(const string& text) {
+    vector<string> lines;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t nl = text.find('\n', start);
+        if (nl == string::npos) nl = text.size();
+        lines.push_back(text.substr(start, nl - start));
+        start = nl + 1;
+    }
+    return lines;
+}
+
+// Path of the node printed on lines[target], rebuilt from the ". " depth
+// prefixes of the lines before it
+static string nodePath(const vector<string>& lines, size_t target) {
+    vector<string> path;
+    vector<int> siblings; // children seen so far at each depth
+    for (size_t i = 0; i <= target && i < lines.size(); i++) {
+        const string& line = lines[i];
+        size_t depth = 0;
+        while (line.compare(depth * 2, 2, ". ") == 0) depth++;
+        string name = line.substr(depth * 2, line.rfind('(') - depth * 2);
+
+        siblings.resize(depth + 1);
+        int index = siblings[depth]++;
+        path.resize(depth);
+        path.push_back(depth == 0 ? name : name + "[" + to_string(index) + "]");
+    }
+
+    string result;
+    for (size_t i = 0; i < path.size(); i++) result += (i ? "/" : "") + path[i];
+    return result;
+}
+
+string firstTreeDifference(const string& expected, const string& actual) {
+    vector<string> want = splitLines(expected);
+    vector<string> got = splitLines(actual);
+
+    size_t line = 0;
+    while (line < want.size() && line < got.size() && want[line] == got[line]) line++;
+
+    ostringstream os;
+    if (line == want.size() && line == got.size()) {
+        os << "trees differ only in trailing whitespace";
+        return os.str();
+    }
+    const vector<string>& shape = line < want.size() ? want : got;
+    os << "first difference at " << nodePath(shape, line) << " (line " << line + 1 << "): expected ";
+    if (line < want.size()) os << "'" << want[line] << "'"; else os << "end of tree";
+    os << ", got ";
+    if (line < got.size()) os << "'" << got[line] << "'"; else os << "end of tree";
+    return os.str();
+}
+
+GoldenVerifier::GoldenVerifier(const vector<GoldenCase>& goldenCases, unsigned threadCount)
+    : cases(goldenCases), threads(threadCount ? threadCount : 1), flatChains(false) {}
+
+vector<GoldenCase> GoldenVerifier::discover(const string& dir) {
+    // The same walk as every other corpus mode, kept to inputs with a golden
+    vector<string> files = findSourceFiles(dir);
+    vector<GoldenCase> found;
+    for (size_t i = 0; i < files.size(); i++) {
+        struct stat info;
+        string golden = files[i] + ".tree";
+        if (stat(golden.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) continue;
+        GoldenCase c;
+        c.name = files[i].substr(dir.size() + 1);
+        c.inputPath = files[i];
+        c.goldenPath = golden;
+        found.push_back(c);
+    }
+    return found;
+}
+
+void GoldenVerifier::worker(atomic<size_t>* next, vector<string>* failures) {
+    Tracer::nameThread("verify worker");
+    NodeArena arena;
+    ostringstream rendered;
+    string source;
+    string golden;
+
+    for (size_t i = next->fetch_add(1); i < cases.size(); i = next->fetch_add(1)) {
+        const GoldenCase& c = cases[i];
+        string& failure = (*failures)[i];
+        Tracer::FileScope traced(c.name);
+
+        {
+            TraceSpan span("read", "io");
+            try {
+                if (!readSourceFile(c.inputPath, source)) {
+                    failure = "cannot read " + c.inputPath;
+                    continue;
+                }
+            } catch (const exception& e) {
+                failure = e.what();
+                continue;
+            }
+            if (!readWholeFile(c.goldenPath, golden)) {
+                failure = "cannot read " + c.goldenPath;
+                continue;
+            }
+        }
+
+        rendered.str("");
+        try {
+            NodeArena::Scope scope(arena);
+            ASTNode* ast;
+            {
+                TraceSpan span("parse", "parse");
+                Parser parser(source);
+                parser.setFlattenChains(flatChains);
+                ast = parser.parseProgram();
+            }
+            if (ast && flatChains) expandChains(ast);
+            if (ast) {
+                TraceSpan span("print", "print");
+                ast->print(0, true, rendered);
+                rendered << "\n";
+            } else {
+                failure = "parse error";
+            }
+        } catch (const exception& e) {
+            failure = e.what();
+        }
+        arena.reset();
+
+        TraceSpan span("compare", "verify");
+        if (failure.empty() && rendered.str() != golden) {
+            failure = firstTreeDifference(golden, rendered.str());
+        }
+    }
+}
+
+size_t GoldenVerifier::run(ostream& report) {
+    vector<string> failures(cases.size());
+    atomic<size_t> next(0);
+
+    vector<thread> pool;
+    unsigned count = (unsigned)min((size_t)threads, cases.size());
+    for (unsigned t = 0; t < count; t++) {
+        pool.push_back(thread(&GoldenVerifier::worker, this, &next, &failures));
+    }
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+
+    size_t failed = 0;
+    for (size_t i = 0; i < cases.size(); i++) {
+        if (failures[i].empty()) continue;
+        report << "FAILED " << cases[i].name << ": " << failures[i] << "\n";
+        failed++;
+    }
+    report << "Results: " << cases.size() - failed << "/" << cases.size() << " tests passed" << endl;
+    return failed;
+}
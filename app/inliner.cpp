@@ -0,0 +1,621 @@
+#include "inliner.h"
+#include "ast_visitor.h"
+#include "call_graph.h"
+#include "symbols.h"
+#include "trace.h"
+#include <map>
+#include <set>
+
+using namespace std;
+
+namespace {
+
+ASTNode* identifier(const string& name) {
+    ASTNode* node = new ASTNode("<identifier>", NK_IDENTIFIER);
+    node->addChild(new ASTNode(name, NK_TEXT));
+    return node;
+}
+
+ASTNode* zero() {
+    ASTNode* node = new ASTNode("<integer>", NK_INTEGER);
+    node->addChild(new ASTNode("0", NK_TEXT));
+    return node;
+}
+
+ASTNode* assignment(const string& name, ASTNode* value) {
+    ASTNode* node = new ASTNode("assign", NK_ASSIGN);
+    node->addChild(identifier(name));
+    node->addChild(value);
+    return node;
+}
+
+// A new node like original, with other children
+ASTNode* rebuilt(const ASTNode* original, const vector<ASTNode*>& children) {
+    ASTNode* node = new ASTNode(original->nodeType, original->kind);
+    node->value = original->value;
+    for (size_t i = 0; i < children.size(); i++) node->addChild(children[i]);
+    return node;
+}
+
+ASTNode* block(const vector<ASTNode*>& statements) {
+    ASTNode* node = new ASTNode("block", NK_BLOCK);
+    for (size_t i = 0; i < statements.size(); i++) node->addChild(statements[i]);
+    return node;
+}
+
+// The statement a case clause runs, or null
+const ASTNode* clauseBody(const ASTNode* clause) {
+    size_t at = clause->kind == NK_OTHERWISE ? 0 : 1;
+    return clause->children.size() > at ? clause->children[at] : nullptr;
+}
+
+// Nodes and calls, counting a shared subtree once per use
+class Counter : public AstVisitor<Counter> {
+public:
+    size_t nodes, calls;
+    Counter() : nodes(0), calls(0) {}
+    VisitAction pre(const ASTNode* node, int) {
+        nodes++;
+        if (node->kind == NK_CALL) calls++;
+        return VISIT_CHILDREN;
+    }
+};
+
+// Every name spelled in a subtree
+class Names : public AstVisitor<Names> {
+public:
+    set<string> found;
+    VisitAction pre(const ASTNode* node, int) {
+        if (node->kind == NK_IDENTIFIER) found.insert(leafText(node));
+        return VISIT_CHILDREN;
+    }
+};
+
+// Effects and shape of a function body
+class BodyScan : public AstVisitor<BodyScan> {
+public:
+    const FunctionInfo& fn;
+    bool local;        // no input, output or writes outside the frame
+    bool returnInLoop; // exit would leave that loop, not the inlined body
+    bool looseExit;    // exit outside any loop ends the function
+    size_t returns, nodes;
+    vector<string> calls;
+    int loops;
+
+    explicit BodyScan(const FunctionInfo& function)
+        : fn(function), local(true), returnInLoop(false), looseExit(false), returns(0), nodes(0), loops(0) {}
+
+    VisitAction pre(const ASTNode* node, int) {
+        nodes++;
+        switch (node->kind) {
+            case NK_READ:
+            case NK_OUTPUT:
+            case NK_EOF:
+                local = false;
+                break;
+            case NK_ASSIGN:
+            case NK_SWAP:
+                for (size_t i = 0; i < node->children.size() && i < (node->kind == NK_SWAP ? 2u : 1u); i++) {
+                    if (!isLocal(leafText(node->children[i]))) local = false;
+                }
+                break;
+            case NK_CALL:
+                if (!node->children.empty()) calls.push_back(leafText(node->children[0]));
+                break;
+            case NK_LOOP:
+                loops++;
+                break;
+            case NK_RETURN:
+                returns++;
+                if (loops) returnInLoop = true;
+                break;
+            case NK_EXIT:
+                if (!loops) looseExit = true;
+                break;
+            default:
+                break;
+        }
+        return VISIT_CHILDREN;
+    }
+
+    void post(const ASTNode* node, int) {
+        if (node->kind == NK_LOOP) loops--;
+    }
+
+private:
+    bool isLocal(const string& name) const {
+        const Symbol* sym = fn.locals.find(name);
+        return sym && sym->kind == SYM_VAR;
+    }
+};
+
+// Returns in tail position: the last statement of a block, either branch of
+// an if or any clause of a case that is itself in tail position
+size_t tailReturns(const ASTNode* stmt) {
+    if (!stmt) return 0;
+    size_t count = 0;
+    switch (stmt->kind) {
+        case NK_RETURN:
+            return 1;
+        case NK_BLOCK:
+            return stmt->children.empty() ? 0 : tailReturns(stmt->children.back());
+        case NK_IF:
+            for (size_t i = 1; i < stmt->children.size(); i++) count += tailReturns(stmt->children[i]);
+            return count;
+        case NK_CASE:
+            for (size_t i = 1; i < stmt->children.size(); i++) count += tailReturns(clauseBody(stmt->children[i]));
+            return count;
+        default:
+            return 0;
+    }
+}
+
+// True if every way through stmt ends in a return
+bool alwaysReturns(const ASTNode* stmt) {
+    if (!stmt) return false;
+    switch (stmt->kind) {
+        case NK_RETURN:
+            return true;
+        case NK_BLOCK:
+            return !stmt->children.empty() && alwaysReturns(stmt->children.back());
+        case NK_IF:
+            return stmt->children.size() == 3 && alwaysReturns(stmt->children[1]) && alwaysReturns(stmt->children[2]);
+        case NK_CASE: {
+            bool otherwise = false;
+            for (size_t i = 1; i < stmt->children.size(); i++) {
+                if (!alwaysReturns(clauseBody(stmt->children[i]))) return false;
+                if (stmt->children[i]->kind == NK_OTHERWISE) otherwise = true;
+            }
+            return otherwise;
+        }
+        default:
+            return false;
+    }
+}
+
+// Locals the body may read before it sets them. Only assignments among the
+// body's top-level statements count as setting a local; any other mention
+// comes first and needs the zero a fresh frame would have.
+vector<string> readBeforeSet(const FunctionInfo& fn, const ASTNode* body) {
+    map<string, int> state; // 0 not seen yet, 1 set, 2 read first
+    for (size_t i = fn.params.size(); i < fn.locals.vars.size(); i++) state[fn.locals.vars[i]] = 0;
+    vector<ASTNode*> statements(1, const_cast<ASTNode*>(body));
+    if (body->kind == NK_BLOCK) statements = body->children;
+    for (size_t i = 0; i < statements.size(); i++) {
+        const ASTNode* stmt = statements[i];
+        bool assigns = stmt->kind == NK_ASSIGN && stmt->children.size() == 2;
+        Names read;
+        read.walk(assigns ? stmt->children[1] : stmt);
+        for (set<string>::iterator it = read.found.begin(); it != read.found.end(); ++it) {
+            map<string, int>::iterator local = state.find(*it);
+            if (local != state.end() && local->second == 0) local->second = 2;
+        }
+        if (assigns) {
+            map<string, int>::iterator local = state.find(leafText(stmt->children[0]));
+            if (local != state.end() && local->second == 0) local->second = 1;
+        }
+    }
+    vector<string> zeroed;
+    for (size_t i = fn.params.size(); i < fn.locals.vars.size(); i++) {
+        if (state[fn.locals.vars[i]] == 2) zeroed.push_back(fn.locals.vars[i]);
+    }
+    return zeroed;
+}
+
+// What the inliner knows about one function
+struct Callee {
+    const FunctionInfo* fn;
+    const ASTNode* body;
+    size_t size;
+    bool pure;
+    bool candidate;        // pure, small, not recursive, no local consts or types
+    bool wrapped;          // runs inside loop ... pool
+    bool initResult;       // some way through ends without a return
+    vector<string> zeroed; // locals read before they are set
+    set<string> names;     // names it needs to see as the globals they are
+    size_t sites;
+};
+
+// Copies a callee body for one call site. Frame variables are renamed and
+// 'return (e)' assigns the result, then exits the wrapping loop if there is
+// one. Subtrees with nothing to rename are shared.
+class Copier {
+public:
+    Copier(const map<string, string>& frame, const string& resultName, bool exits)
+        : names(frame), result(resultName), wrapped(exits) {}
+
+    void statement(const ASTNode* stmt, vector<ASTNode*>& out) {
+        if (stmt->kind != NK_RETURN) {
+            out.push_back(copy(stmt));
+            return;
+        }
+        out.push_back(assignment(result, stmt->children.empty() ? zero() : copy(stmt->children[0])));
+        if (wrapped) out.push_back(new ASTNode("exit", NK_EXIT));
+    }
+
+    ASTNode* copy(const ASTNode* node) {
+        if (node->kind == NK_IDENTIFIER) {
+            map<string, string>::const_iterator it = names.find(leafText(node));
+            return it == names.end() ? const_cast<ASTNode*>(node) : identifier(it->second);
+        }
+        if (node->kind == NK_RETURN) {
+            vector<ASTNode*> out;
+            statement(node, out);
+            return out.size() == 1 ? out[0] : block(out);
+        }
+        bool listed = node->kind == NK_BLOCK || node->kind == NK_LOOP || node->kind == NK_REPEAT;
+        vector<ASTNode*> children;
+        bool changed = false;
+        for (size_t i = 0; i < node->children.size(); i++) {
+            ASTNode* child = node->children[i];
+            if (node->kind == NK_CALL && i == 0) {
+                // Calls name functions, never frame variables
+                children.push_back(child);
+            } else if (listed && child->kind == NK_RETURN) {
+                statement(child, children);
+                changed = true;
+            } else {
+                ASTNode* copied = copy(child);
+                changed = changed || copied != child;
+                children.push_back(copied);
+            }
+        }
+        return changed ? rebuilt(node, children) : const_cast<ASTNode*>(node);
+    }
+
+private:
+    const map<string, string>& names;
+    string result;
+    bool wrapped;
+};
+
+// Rewrites one caller at a time, collecting the variables it must declare
+class Rewriter {
+public:
+    vector<ASTNode*> declarations;
+
+    Rewriter(const ASTNode* root, const ProgramInfo& programInfo, vector<Callee>& functions)
+        : program(root), info(programInfo), callees(functions), sites(0) {}
+
+    // Starts a caller; fn is null for the main block
+    void enter(const FunctionInfo* fn, const ASTNode* types) {
+        declarations.clear();
+        shadowed.clear();
+        if (!fn) return;
+        for (map<string, Symbol>::const_iterator it = fn->locals.symbols.begin(); it != fn->locals.symbols.end(); ++it) {
+            shadowed.insert(it->first);
+        }
+        for (size_t i = 0; i < types->children.size(); i++) {
+            if (!types->children[i]->children.empty()) shadowed.insert(leafText(types->children[i]->children[0]));
+        }
+    }
+
+    // Appends stmt, preceded by the expansions of the calls it makes
+    void statement(ASTNode* stmt, vector<ASTNode*>& out) {
+        vector<ASTNode*> pre;
+        vector<ASTNode*> children(stmt->children);
+        bool effects = false;
+        switch (stmt->kind) {
+            case NK_BLOCK:
+            case NK_LOOP:
+                children.clear();
+                for (size_t i = 0; i < stmt->children.size(); i++) statement(stmt->children[i], children);
+                break;
+            case NK_REPEAT:
+                // The test runs after the body, so its calls expand at the end of it
+                children.clear();
+                for (size_t i = 0; i + 1 < stmt->children.size(); i++) statement(stmt->children[i], children);
+                if (!stmt->children.empty()) {
+                    ASTNode* test = expression(stmt->children.back(), effects, children);
+                    children.push_back(test);
+                }
+                break;
+            case NK_ASSIGN:
+                if (children.size() == 2) children[1] = expression(children[1], effects, pre);
+                break;
+            case NK_OUTPUT:
+                // Each item is printed before the next is evaluated
+                for (size_t i = 0; i < children.size(); i++) {
+                    ASTNode* item = children[i];
+                    if (item->kind == NK_OUTPUT_INTEGER && !item->children.empty()) {
+                        ASTNode* value = expression(item->children[0], effects, pre);
+                        if (value != item->children[0]) children[i] = rebuilt(item, vector<ASTNode*>(1, value));
+                    }
+                    effects = true;
+                }
+                break;
+            case NK_IF:
+                if (!children.empty()) children[0] = expression(children[0], effects, pre);
+                for (size_t i = 1; i < children.size(); i++) children[i] = single(children[i]);
+                break;
+            case NK_WHILE:
+                if (children.size() > 1) children[1] = single(children[1]);
+                break;
+            case NK_FOR:
+                if (children.size() == 4) {
+                    statement(children[0], pre);
+                    children[0] = pre.back();
+                    pre.pop_back();
+                    children[3] = single(children[3]);
+                }
+                break;
+            case NK_CASE:
+                if (!children.empty()) children[0] = expression(children[0], effects, pre);
+                for (size_t i = 1; i < children.size(); i++) {
+                    ASTNode* clause = children[i];
+                    size_t at = clause->kind == NK_OTHERWISE ? 0 : 1;
+                    if (clause->children.size() <= at) continue;
+                    vector<ASTNode*> parts(clause->children);
+                    parts[at] = single(parts[at]);
+                    if (parts != clause->children) children[i] = rebuilt(clause, parts);
+                }
+                break;
+            case NK_RETURN:
+                if (!children.empty()) children[0] = expression(children[0], effects, pre);
+                break;
+            default:
+                break;
+        }
+        out.insert(out.end(), pre.begin(), pre.end());
+        out.push_back(children == stmt->children ? stmt : rebuilt(stmt, children));
+    }
+
+    // stmt where only one statement may stand, in a block if it grew
+    ASTNode* single(ASTNode* stmt) {
+        vector<ASTNode*> out;
+        statement(stmt, out);
+        return out.size() == 1 ? out[0] : block(out);
+    }
+
+private:
+    const ASTNode* program;
+    const ProgramInfo& info;
+    vector<Callee>& callees;
+    Names taken;          // every name in use, so fresh ones cannot clash
+    set<string> shadowed; // names the caller declares itself
+    size_t sites;
+
+    Callee* resolve(const ASTNode* call) {
+        const FunctionInfo* fn = info.findFunction(leafText(call->children[0]));
+        return fn ? &callees[fn - &info.functions[0]] : nullptr;
+    }
+
+    bool inlinable(const Callee& callee, size_t arguments) const {
+        if (!callee.candidate || arguments != callee.fn->params.size()) return false;
+        for (set<string>::const_iterator it = callee.names.begin(); it != callee.names.end(); ++it) {
+            if (shadowed.count(*it)) return false;
+        }
+        return true;
+    }
+
+    bool hasEffects(const ASTNode* expr) {
+        if (expr->kind == NK_EOF) return true;
+        if (expr->kind == NK_CALL) {
+            const Callee* callee = resolve(expr);
+            if (!callee || !callee->pure) return true;
+        }
+        for (size_t i = 0; i < expr->children.size(); i++) {
+            if (hasEffects(expr->children[i])) return true;
+        }
+        return false;
+    }
+
+    // expr with the calls that can move ahead of its statement expanded
+    // into pre, in the order they are evaluated. effects is set once
+    // something that stays in place has read input or changed state.
+    ASTNode* expression(ASTNode* expr, bool& effects, vector<ASTNode*>& pre) {
+        vector<ASTNode*> children(expr->children);
+        switch (expr->kind) {
+            case NK_EOF:
+                effects = true;
+                return expr;
+            case NK_AND:
+            case NK_OR:
+                // Only the first operand is always evaluated
+                if (children.empty()) return expr;
+                children[0] = expression(children[0], effects, pre);
+                for (size_t i = 1; i < children.size(); i++) {
+                    if (hasEffects(children[i])) effects = true;
+                }
+                break;
+            case NK_CALL: {
+                if (children.empty()) return expr;
+                for (size_t i = 1; i < children.size(); i++) children[i] = expression(children[i], effects, pre);
+                Callee* callee = resolve(expr);
+                if (!effects && callee && inlinable(*callee, children.size() - 1)) {
+                    return expand(*callee, vector<ASTNode*>(children.begin() + 1, children.end()), pre);
+                }
+                if (!callee || !callee->pure) effects = true;
+                break;
+            }
+            default:
+                for (size_t i = 0; i < children.size(); i++) children[i] = expression(children[i], effects, pre);
+                break;
+        }
+        return children == expr->children ? expr : rebuilt(expr, children);
+    }
+
+    // Declares a variable for the caller under an unused name
+    string declare(const string& base, const string& type) {
+        if (taken.found.empty()) taken.walk(program);
+        string name = base;
+        for (int n = 2; taken.found.count(name); n++) name = base + "_" + to_string(n);
+        taken.found.insert(name);
+        ASTNode* var = new ASTNode("var", NK_VAR);
+        var->addChild(identifier(name));
+        var->addChild(identifier(type));
+        declarations.push_back(var);
+        return name;
+    }
+
+    // Appends the callee's body for one call to pre; returns the value of the call
+    ASTNode* expand(Callee& callee, const vector<ASTNode*>& arguments, vector<ASTNode*>& pre) {
+        const FunctionInfo& fn = *callee.fn;
+        string site = to_string(++sites);
+        map<string, string> frame;
+        for (size_t i = 0; i < fn.locals.vars.size(); i++) {
+            const string& var = fn.locals.vars[i];
+            frame[var] = declare(fn.name + "_" + var + "_" + site, fn.locals.find(var)->typeName);
+        }
+        string result = declare(fn.name + "_" + site, leafText(fn.node->children[2]));
+
+        for (size_t i = 0; i < fn.params.size(); i++) pre.push_back(assignment(frame[fn.params[i]], arguments[i]));
+        for (size_t i = 0; i < callee.zeroed.size(); i++) pre.push_back(assignment(frame[callee.zeroed[i]], zero()));
+        if (callee.initResult) pre.push_back(assignment(result, zero()));
+
+        Copier copier(frame, result, callee.wrapped);
+        vector<ASTNode*> body;
+        if (callee.body->kind == NK_BLOCK) {
+            for (size_t i = 0; i < callee.body->children.size(); i++) copier.statement(callee.body->children[i], body);
+        } else {
+            copier.statement(callee.body, body);
+        }
+        if (callee.wrapped) {
+            ASTNode* loop = new ASTNode("loop", NK_LOOP);
+            for (size_t i = 0; i < body.size(); i++) loop->addChild(body[i]);
+            if (!alwaysReturns(callee.body)) loop->addChild(new ASTNode("exit", NK_EXIT));
+            pre.push_back(loop);
+        } else {
+            pre.insert(pre.end(), body.begin(), body.end());
+        }
+        callee.sites++;
+        return identifier(result);
+    }
+};
+
+// dclns with the caller's new variables at the end
+ASTNode* withDeclarations(ASTNode* dclns, const vector<ASTNode*>& vars) {
+    if (vars.empty()) return dclns;
+    vector<ASTNode*> children(dclns->children);
+    children.insert(children.end(), vars.begin(), vars.end());
+    return rebuilt(dclns, children);
+}
+
+}
+
+Inliner::Inliner(size_t maxSize)
+    : maximum(maxSize), callSites(0), inlined(0), nodesBefore(0), nodesAfter(0) {}
+
+ASTNode* Inliner::run(const ASTNode* program) {
+    TraceSpan span("inline", "semantic");
+    ProgramInfo info(program);
+    CallGraph graph = buildCallGraph(program, 1);
+    vector<vector<uint32_t> > recursive = recursiveComponents(graph);
+    vector<char> recursion(graph.functionCount(), 0);
+    for (size_t c = 0; c < recursive.size(); c++) {
+        for (size_t i = 0; i < recursive[c].size(); i++) recursion[recursive[c][i]] = 1;
+    }
+
+    Counter before;
+    before.walk(program);
+    nodesBefore = before.nodes;
+    callSites = before.calls;
+
+    vector<Callee> functions(info.functions.size());
+    for (size_t f = 0; f < functions.size(); f++) {
+        const FunctionInfo& fn = info.functions[f];
+        const ASTNode* fcn = fn.node;
+        Callee& callee = functions[f];
+        callee.fn = &fn;
+        callee.body = fcn->children[6];
+        callee.sites = 0;
+
+        BodyScan scan(fn);
+        scan.walk(callee.body);
+        callee.size = scan.nodes;
+        callee.pure = scan.local;
+        for (size_t i = 0; i < scan.calls.size(); i++) {
+            if (!info.findFunction(scan.calls[i])) callee.pure = false;
+        }
+        callee.candidate = !recursion[f] && callee.size <= maximum && !scan.returnInLoop &&
+                           fcn->children[3]->children.empty() && fcn->children[4]->children.empty();
+        callee.wrapped = scan.looseExit || tailReturns(callee.body) != scan.returns;
+        callee.initResult = scan.looseExit || !alwaysReturns(callee.body);
+    }
+
+    // A function is pure only if everything it calls is; the graph has the
+    // same numbering and resolves names the same way
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t f = 0; f < functions.size(); f++) {
+            if (!functions[f].pure) continue;
+            for (uint32_t e = graph.calleeStart[f]; e < graph.calleeStart[f + 1]; e++) {
+                if (!functions[graph.callees[e]].pure) {
+                    functions[f].pure = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    // The rest only matters for functions that can be inlined, which are small
+    bool any = false;
+    for (size_t f = 0; f < functions.size(); f++) {
+        Callee& callee = functions[f];
+        const FunctionInfo& fn = info.functions[f];
+        callee.candidate = callee.candidate && callee.pure;
+        if (!callee.candidate) continue;
+        any = true;
+        Names mentioned;
+        mentioned.walk(callee.body);
+        for (set<string>::iterator it = mentioned.found.begin(); it != mentioned.found.end(); ++it) {
+            const Symbol* sym = fn.locals.find(*it);
+            if (!sym || sym->kind != SYM_VAR) callee.names.insert(*it);
+        }
+        for (size_t i = 0; i < fn.locals.vars.size(); i++) {
+            callee.names.insert(fn.locals.find(fn.locals.vars[i])->typeName);
+        }
+        callee.names.insert(leafText(fn.node->children[2]));
+        callee.zeroed = readBeforeSet(fn, callee.body);
+    }
+    inlined = 0;
+    callees.clear();
+    nodesAfter = nodesBefore;
+    if (!any) return const_cast<ASTNode*>(program);
+
+    Rewriter rewriter(program, info, functions);
+
+    // Callers are the functions in order, then the main block
+    vector<ASTNode*> parts(program->children);
+    const ASTNode* subprogs = program->children[4];
+    vector<ASTNode*> fcns(subprogs->children);
+    for (size_t f = 0; f < fcns.size(); f++) {
+        const ASTNode* fcn = fcns[f];
+        rewriter.enter(&info.functions[f], fcn->children[4]);
+        ASTNode* body = rewriter.single(fcn->children[6]);
+        if (body == fcn->children[6]) continue;
+        vector<ASTNode*> pieces(fcn->children);
+        pieces[5] = withDeclarations(pieces[5], rewriter.declarations);
+        pieces[6] = body;
+        fcns[f] = rebuilt(fcn, pieces);
+    }
+    if (fcns != subprogs->children) parts[4] = rebuilt(subprogs, fcns);
+    rewriter.enter(nullptr, nullptr);
+    parts[5] = rewriter.single(parts[5]);
+    parts[3] = withDeclarations(parts[3], rewriter.declarations);
+    if (parts == program->children) return const_cast<ASTNode*>(program);
+    ASTNode* result = rebuilt(program, parts);
+
+    for (size_t f = 0; f < functions.size(); f++) {
+        if (!functions[f].sites) continue;
+        Expanded expanded = {functions[f].fn->name, functions[f].sites, functions[f].size};
+        callees.push_back(expanded);
+        inlined += functions[f].sites;
+    }
+    Counter after;
+    after.walk(result);
+    nodesAfter = after.nodes;
+    return result;
+}
+
+void Inliner::report(ostream& out) const {
+    long change = (long)nodesAfter - (long)nodesBefore;
+    out << "inlined: " << inlined << " of " << callSites << " call sites\n";
+    out << "nodes: " << nodesBefore << " -> " << nodesAfter << " (" << (change >= 0 ? "+" : "") << change << ")\n";
+    for (size_t i = 0; i < callees.size(); i++) {
+        out << "  " << callees[i].name << ": " << callees[i].sites << (callees[i].sites == 1 ? " site" : " sites")
+            << ", " << callees[i].size << "-node body\n";
+    }
+}
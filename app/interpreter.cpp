@@ -0,0 +1,238 @@
+#include "interpreter.h"
+#include <cstdio>
+#include <stdexcept>
+
+using namespace std;
+
+static int wrap(unsigned int value) {
+    return (int)value;
+}
+
+static int checkedDivisor(int b) {
+    if (b == 0) throw runtime_error("division by zero");
+    return b;
+}
+
+Interpreter::Interpreter(const ASTNode* root, const ProgramInfo& programInfo)
+    : program(root), info(programInfo), globals(programInfo.globals.vars.size(), 0),
+      frame(nullptr), current(nullptr), returnValue(0) {}
+
+void Interpreter::run() {
+    execute(program->children[5]);
+    fflush(stdout);
+}
+
+int Interpreter::skipSpace() {
+    int c;
+    do c = getchar(); while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+    if (c != EOF) ungetc(c, stdin);
+    return c;
+}
+
+int Interpreter::readInteger() {
+    int v = 0;
+    skipSpace();
+    if (scanf("%d", &v) == 0) getchar(); // skip a character that cannot start a number
+    return v;
+}
+
+int Interpreter::readCharacter() {
+    skipSpace();
+    int c = getchar();
+    return c == EOF ? 0 : c;
+}
+
+int& Interpreter::variable(const ASTNode* identifier) {
+    string name = leafText(identifier);
+    const Symbol* sym = info.lookup(current, name);
+    if (!sym || sym->kind != SYM_VAR) {
+        throw runtime_error("'" + name + "' is not a variable");
+    }
+    if (current && sym == current->locals.find(name)) return (*frame)[sym->slot];
+    return globals[sym->slot];
+}
+
+Interpreter::Flow Interpreter::execute(const ASTNode* stmt) {
+    if (!stmt) return FLOW_NORMAL;
+    const string& type = stmt->nodeType;
+    const vector<ASTNode*>& kids = stmt->children;
+
+    if (type == "block") {
+        for (size_t i = 0; i < kids.size(); i++) {
+            Flow flow = execute(kids[i]);
+            if (flow != FLOW_NORMAL) return flow;
+        }
+    } else if (type == "assign") {
+        int value = evaluate(kids[1]);
+        variable(kids[0]) = value;
+    } else if (type == "swap") {
+        int& a = variable(kids[0]);
+        int& b = variable(kids[1]);
+        int t = a;
+        a = b;
+        b = t;
+    } else if (type == "output") {
+        for (size_t i = 0; i < kids.size(); i++) {
+            const ASTNode* item = kids[i];
+            if (item->nodeType == "string") {
+                string text = leafText(item->children[0]);
+                if (text.size() >= 2 && text[0] == '"') text = text.substr(1, text.size() - 2);
+                puts(text.c_str());
+            } else {
+                printf("%d\n", evaluate(item->children[0]));
+            }
+        }
+    } else if (type == "if") {
+        if (evaluate(kids[0])) {
+            if (kids.size() > 1) return execute(kids[1]);
+        } else if (kids.size() > 2) {
+            return execute(kids[2]);
+        }
+    } else if (type == "while") {
+        while (evaluate(kids[0])) {
+            Flow flow = kids.size() > 1 ? execute(kids[1]) : FLOW_NORMAL;
+            if (flow != FLOW_NORMAL) return flow;
+        }
+    } else if (type == "repeat") {
+        do {
+            for (size_t i = 0; i + 1 < kids.size(); i++) {
+                Flow flow = execute(kids[i]);
+                if (flow != FLOW_NORMAL) return flow;
+            }
+        } while (!evaluate(kids.back()));
+    } else if (type == "for") {
+        execute(kids[0]);
+        while (evaluate(kids[1])) {
+            Flow flow = execute(kids[3]);
+            if (flow != FLOW_NORMAL) return flow;
+            execute(kids[2]);
+        }
+    } else if (type == "loop") {
+        for (;;) {
+            for (size_t i = 0; i < kids.size(); i++) {
+                Flow flow = execute(kids[i]);
+                if (flow == FLOW_EXIT) return FLOW_NORMAL;
+                if (flow != FLOW_NORMAL) return flow;
+            }
+        }
+    } else if (type == "exit") {
+        return FLOW_EXIT;
+    } else if (type == "case") {
+        return executeCase(stmt);
+    } else if (type == "read") {
+        for (size_t i = 0; i < kids.size(); i++) {
+            const Symbol* sym = info.lookup(current, leafText(kids[i]));
+            bool isChar = sym && sym->typeName == "char";
+            int value = isChar ? readCharacter() : readInteger();
+            variable(kids[i]) = value;
+        }
+    } else if (type == "return") {
+        returnValue = kids.empty() ? 0 : evaluate(kids[0]);
+        return FLOW_RETURN;
+    } else if (type != "<null>") {
+        throw runtime_error("cannot execute statement '" + type + "'");
+    }
+    return FLOW_NORMAL;
+}
+
+Interpreter::Flow Interpreter::executeCase(const ASTNode* caseNode) {
+    int selector = evaluate(caseNode->children[0]);
+
+    for (size_t i = 1; i < caseNode->children.size(); i++) {
+        const ASTNode* clause = caseNode->children[i];
+        if (clause->nodeType == "otherwise") {
+            return clause->children.empty() ? FLOW_NORMAL : execute(clause->children[0]);
+        }
+
+        const ASTNode* label = clause->children[0];
+        bool hit;
+        if (label->nodeType == "..") {
+            hit = selector >= evaluate(label->children[0]) && selector <= evaluate(label->children[1]);
+        } else {
+            hit = selector == evaluate(label);
+        }
+        if (hit) {
+            return clause->children.size() > 1 ? execute(clause->children[1]) : FLOW_NORMAL;
+        }
+    }
+    return FLOW_NORMAL;
+}
+
+int Interpreter::call(const ASTNode* callNode) {
+    string name = leafText(callNode->children[0]);
+    const FunctionInfo* fn = info.findFunction(name);
+    if (!fn) throw runtime_error("call to undefined function '" + name + "'");
+    if (fn->params.size() != callNode->children.size() - 1) {
+        throw runtime_error("wrong number of arguments to '" + name + "'");
+    }
+
+    // Arguments are evaluated left to right in the caller's frame
+    vector<int> locals(fn->locals.vars.size(), 0);
+    for (size_t i = 0; i < fn->params.size(); i++) {
+        locals[i] = evaluate(callNode->children[i + 1]);
+    }
+
+    vector<int>* savedFrame = frame;
+    const FunctionInfo* savedFunction = current;
+    frame = &locals;
+    current = fn;
+
+    int result = execute(fn->node->children[6]) == FLOW_RETURN ? returnValue : 0;
+
+    frame = savedFrame;
+    current = savedFunction;
+    return result;
+}
+
+int Interpreter::evaluate(const ASTNode* node) {
+    if (!node) throw runtime_error("missing expression");
+    const string& type = node->nodeType;
+    const vector<ASTNode*>& kids = node->children;
+
+    if (type == "<integer>") return integerValue(leafText(node));
+    if (type == "<char>") return charValue(leafText(node));
+    if (type == "true") return 1;
+    if (type == "eof") return skipSpace() == EOF;
+
+    if (type == "<identifier>") {
+        string name = leafText(node);
+        const Symbol* sym = info.lookup(current, name);
+        if (!sym || sym->kind == SYM_FUNCTION) {
+            throw runtime_error("'" + name + "' cannot be used as a value");
+        }
+        if (sym->kind == SYM_VAR) return variable(node);
+        return sym->value;
+    }
+
+    if (type == "call") return call(node);
+
+    if (kids.size() == 1) {
+        unsigned int a = evaluate(kids[0]);
+        if (type == "-") return wrap(0u - a);
+        if (type == "not") return !a;
+        if (type == "succ") return wrap(a + 1u);
+        if (type == "pred") return wrap(a - 1u);
+        if (type == "chr" || type == "ord") return wrap(a);
+    }
+
+    if (kids.size() == 2) {
+        if (type == "and") return evaluate(kids[0]) && evaluate(kids[1]);
+        if (type == "or") return evaluate(kids[0]) || evaluate(kids[1]);
+
+        int a = evaluate(kids[0]);
+        int b = evaluate(kids[1]);
+        if (type == "+") return wrap((unsigned int)a + (unsigned int)b);
+        if (type == "-") return wrap((unsigned int)a - (unsigned int)b);
+        if (type == "*") return wrap((unsigned int)a * (unsigned int)b);
+        if (type == "/") return checkedDivisor(b) == -1 ? wrap(0u - (unsigned int)a) : a / b;
+        if (type == "mod") return checkedDivisor(b) == -1 ? 0 : a % b;
+        if (type == "=") return a == b;
+        if (type == "<>") return a != b;
+        if (type == "<") return a < b;
+        if (type == "<=") return a <= b;
+        if (type == ">") return a > b;
+        if (type == ">=") return a >= b;
+    }
+
+    throw runtime_error("cannot evaluate expression '" + type + "'");
+}
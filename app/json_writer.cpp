@@ -0,0 +1,122 @@
+#include "json_writer.h"
+#include <cstring>
+#include <stdint.h>
+
+using namespace std;
+
+static const uint64_t ONES = 0x0101010101010101ULL;
+static const uint64_t HIGHS = 0x8080808080808080ULL;
+
+// Non-zero if any byte of word is zero (exact for the lowest such byte)
+static inline uint64_t zeroByte(uint64_t word) {
+    return (word - ONES) & ~word & HIGHS;
+}
+
+// Non-zero if any byte needs escaping: '"', '\\' or below 0x20
+static inline uint64_t needsEscape(uint64_t word) {
+    return zeroByte(word ^ (ONES * '"')) | zeroByte(word ^ (ONES * '\\')) |
+           ((word - ONES * 0x20) & ~word & HIGHS);
+}
+
+JsonWriter::JsonWriter(ostream& os) : out(os), used(0) {}
+
+JsonWriter::~JsonWriter() {
+    flush();
+}
+
+void JsonWriter::flush() {
+    if (used) out.write(buffer, used);
+    used = 0;
+}
+
+void JsonWriter::raw(const char* text, size_t size) {
+    if (size > BUFFER_BYTES - used) {
+        flush();
+        if (size > BUFFER_BYTES) {
+            out.write(text, size);
+            return;
+        }
+    }
+    memcpy(buffer + used, text, size);
+    used += size;
+}
+
+void JsonWriter::raw(const char* text) {
+    raw(text, strlen(text));
+}
+
+void JsonWriter::escapeByte(unsigned char c) {
+    static const char hex[] = "0123456789abcdef";
+    switch (c) {
+        case '"': raw("\\\"", 2); return;
+        case '\\': raw("\\\\", 2); return;
+        case '\n': raw("\\n", 2); return;
+        case '\t': raw("\\t", 2); return;
+        case '\r': raw("\\r", 2); return;
+        case '\b': raw("\\b", 2); return;
+        case '\f': raw("\\f", 2); return;
+        default: break;
+    }
+    if (c < 0x20) {
+        char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+        raw(escaped, 6);
+    } else {
+        put((char)c);
+    }
+}
+
+void JsonWriter::string(const std::string& text) {
+    put('"');
+    const char* p = text.data();
+    size_t size = text.size();
+    size_t i = 0;
+
+    while (i + 8 <= size) {
+        uint64_t word;
+        memcpy(&word, p + i, 8);
+        if (!needsEscape(word)) {
+            raw(p + i, 8);
+        } else {
+            for (size_t k = 0; k < 8; k++) escapeByte((unsigned char)p[i + k]);
+        }
+        i += 8;
+    }
+    for (; i < size; i++) escapeByte((unsigned char)p[i]);
+    put('"');
+}
+
+static bool isLiteralWrapper(const ASTNode* node) {
+    return node->children.size() == 1 && node->children[0]->children.empty() &&
+           node->nodeType.size() > 2 && node->nodeType[0] == '<';
+}
+
+static void writeNode(const ASTNode* node, JsonWriter& json) {
+    json.raw("{\"type\":");
+    json.string(node->nodeType);
+
+    if (isLiteralWrapper(node)) {
+        json.raw(",\"value\":");
+        json.string(node->children[0]->nodeType);
+        json.raw("}");
+        return;
+    }
+    if (!node->value.empty()) {
+        json.raw(",\"value\":");
+        json.string(node->value);
+    }
+    if (!node->children.empty()) {
+        json.raw(",\"children\":[");
+        for (size_t i = 0; i < node->children.size(); i++) {
+            if (i) json.raw(",", 1);
+            writeNode(node->children[i], json);
+        }
+        json.raw("]");
+    }
+    json.raw("}");
+}
+
+void writeJsonTree(const ASTNode* root, ostream& out) {
+    JsonWriter json(out);
+    writeNode(root, json);
+    json.raw("\n", 1);
+}
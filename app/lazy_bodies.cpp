@@ -0,0 +1,56 @@
+#include "lazy_bodies.h"
+#include "parser.h"
+#include "node_interner.h"
+#include "ast_visitor.h"
+#include "trace.h"
+
+using namespace std;
+
+// Where the block sits among a fcn's children
+static const size_t BODY_CHILD = 6;
+
+LazyBodies::LazyBodies(const string& source) : text(source), flat(false) {}
+
+ASTNode* LazyBodies::defer(size_t begin, size_t end) {
+    if (end > text.size() || end < begin) end = text.size();
+    ASTNode* placeholder = new ASTNode("<lazy>", NK_UNKNOWN);
+    // Unique, so an interner never merges two functions with the same signature
+    placeholder->value = to_string(begin);
+    Range range = {begin, end};
+    ranges[placeholder] = range;
+    return placeholder;
+}
+
+bool LazyBodies::pending(const ASTNode* fcn) const {
+    return fcn->children.size() > BODY_CHILD && ranges.count(fcn->children[BODY_CHILD]) != 0;
+}
+
+ASTNode* LazyBodies::materialize(ASTNode* fcn) {
+    if (fcn->children.size() <= BODY_CHILD) return nullptr;
+    ASTNode*& body = fcn->children[BODY_CHILD];
+    unordered_map<const ASTNode*, Range>::iterator it = ranges.find(body);
+    if (it == ranges.end()) return body; // parsed already
+
+    TraceSpan span("materialize", "parse");
+    if (span.active()) span.setDetail(fcn->children[0]->children[0]->nodeType);
+    // Offsets in errors stay those of the whole source
+    Parser parser(text.substr(it->second.begin, it->second.end - it->second.begin), it->second.begin);
+    parser.setLimits(limits);
+    parser.setFlattenChains(flat);
+    // Interned like any other child when an interner is active
+    body = NodeInterner::share(parser.parseBody());
+    ranges.erase(it);
+    return body;
+}
+
+size_t LazyBodies::materializeAll(ASTNode* program) {
+    const ASTNode* subprogs = findSubprogs(program);
+    if (!subprogs) return 0;
+    size_t parsed = 0;
+    for (size_t i = 0; i < subprogs->children.size(); i++) {
+        if (!pending(subprogs->children[i])) continue;
+        materialize(subprogs->children[i]);
+        parsed++;
+    }
+    return parsed;
+}
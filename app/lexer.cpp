@@ -1,13 +1,79 @@
 #include "lexer.h"
 #include <cctype>
+#include <algorithm>
 
 using namespace std;
 
-Lexer::Lexer(const string& text) : input(text), pos(0), line(1), column(1) {
-    initKeywords();
+void checkSourceSize(size_t bytes) {
+    if (bytes > MAX_SOURCE_BYTES) {
+        throw ResourceLimitError("source is larger than 4 GB, the limit of 32-bit token offsets");
+    }
+}
+
+Lexer::Lexer(const string& text, size_t baseOffset)
+    : input(text), pos(0), base(baseOffset), keywords(keywordTable()), stream(nullptr), windowSize(0),
+      streamDone(true), lastRead('\n'), keep(string::npos), lineCursor(baseOffset), lineStart(baseOffset), lineNumber(1) {
+    checkSourceSize(base + input.size());
+}
+
+Lexer::Lexer(istream& in, size_t windowBytes)
+    : pos(0), base(0), keywords(keywordTable()), stream(&in), windowSize(windowBytes ? windowBytes : 1),
+      streamDone(false), lastRead('\n'), keep(string::npos), lineCursor(0), lineStart(0), lineNumber(1) {
+    input.reserve(windowSize);
+}
+
+bool Lexer::refill(size_t count) {
+    if (streamDone) return false;
+    
+    // Drop what was read, except the token being lexed
+    size_t drop = keep >= base + pos ? pos : keep - base;
+    trackLines(base + drop);
+    input.erase(0, drop);
+    base += drop;
+    pos -= drop;
+    
+    while (pos + count > input.size() && !streamDone) {
+        size_t have = input.size();
+        input.resize(max(have + windowSize, pos + count));
+        stream->read(&input[have], input.size() - have);
+        size_t got = (size_t)stream->gcount();
+        input.resize(have + got);
+        if (got) {
+            lastRead = input[input.size() - 1];
+        } else {
+            streamDone = true;
+            if (lastRead != '\n') input += '\n';
+        }
+        // Offsets past 4 GB would wrap, and with them locate's positions
+        checkSourceSize(base + input.size());
+    }
+    return pos + count <= input.size();
+}
+
+void Lexer::trackLines(size_t offset) {
+    // Everything from lineCursor on is still in the window
+    for (size_t i = lineCursor; i < offset; i++) {
+        if (input[i - base] == '\n') {
+            lineNumber++;
+            lineStart = i + 1;
+        }
+    }
+    if (offset > lineCursor) lineCursor = offset;
 }
 
-void Lexer::initKeywords() {
+void Lexer::locate(size_t offset, int& line, int& column) {
+    trackLines(offset);
+    line = lineNumber;
+    column = (int)(offset - lineStart) + 1;
+}
+
+const map<string, TokenType>& Lexer::keywordTable() {
+    static const map<string, TokenType> table = initKeywords();
+    return table;
+}
+
+map<string, TokenType> Lexer::initKeywords() {
+    map<string, TokenType> keywords;
     keywords["program"] = TOK_PROGRAM;
     keywords["var"] = TOK_VAR;
     keywords["const"] = TOK_CONST;
@@ -45,27 +111,21 @@ void Lexer::initKeywords() {
     keywords["false"] = TOK_FALSE;
     keywords["boolean"] = TOK_BOOLEAN;
     keywords["integer"] = TOK_INTEGER_TYPE;
+    return keywords;
 }
 
 char Lexer::peek(int offset) {
-    if (pos + offset >= input.length()) return '\0';
+    if (!available(offset + 1)) return '\0';
     return input[pos + offset];
 }
 
 char Lexer::advance() {
-    if (pos >= input.length()) return '\0';
-    char c = input[pos++];
-    if (c == '\n') {
-        line++;
-        column = 1;
-    } else {
-        column++;
-    }
-    return c;
+    if (!available(1)) return '\0';
+    return input[pos++];
 }
 
 void Lexer::skipWhitespace() {
-    while (pos < input.length() && isspace(peek()) && peek() != '\n') {
+    while (available(1) && isspace(peek()) && peek() != '\n') {
         advance();
     }
 }
@@ -73,13 +133,13 @@ void Lexer::skipWhitespace() {
 void Lexer::skipComment() {
     if (peek() == '#') {
         // Line comment
-        while (pos < input.length() && peek() != '\n') {
+        while (available(1) && peek() != '\n') {
             advance();
         }
     } else if (peek() == '{') {
         // Block comment
         advance(); // skip '{'
-        while (pos < input.length()) {
+        while (available(1)) {
             if (peek() == '}') {
                 advance(); // skip '}'
                 break;
@@ -91,37 +151,38 @@ void Lexer::skipComment() {
 
 Token Lexer::readIdentifier() {
     string value;
-    int startLine = line, startCol = column;
+    size_t start = base + pos;
     
-    while (pos < input.length() && (isalnum(peek()) || peek() == '_')) {
+    while (available(1) && (isalnum(peek()) || peek() == '_')) {
         value += advance();
     }
     
     TokenType type = TOK_IDENTIFIER;
-    if (keywords.find(value) != keywords.end()) {
-        type = keywords[value];
+    map<string, TokenType>::const_iterator kw = keywords.find(value);
+    if (kw != keywords.end()) {
+        type = kw->second;
     }
     
-    return Token(type, value, startLine, startCol);
+    return Token(type, value, start);
 }
 
 Token Lexer::readNumber() {
     string value;
-    int startLine = line, startCol = column;
+    size_t start = base + pos;
     
-    while (pos < input.length() && isdigit(peek())) {
+    while (available(1) && isdigit(peek())) {
         value += advance();
     }
     
-    return Token(TOK_INTEGER, value, startLine, startCol);
+    return Token(TOK_INTEGER, value, start);
 }
 
 Token Lexer::readChar() {
-    int startLine = line, startCol = column;
+    size_t start = base + pos;
     advance(); // skip opening '
     
-    if (pos >= input.length()) {
-        return Token(TOK_UNKNOWN, "", startLine, startCol);
+    if (!available(1)) {
+        return Token(TOK_UNKNOWN, "", start);
     }
     
     char c = advance();
@@ -129,48 +190,51 @@ Token Lexer::readChar() {
     value += c;
     value += "'";
     
-    if (pos < input.length() && peek() == '\'') {
+    if (available(1) && peek() == '\'') {
         advance(); // skip closing '
     }
     
-    return Token(TOK_CHAR, value, startLine, startCol);
+    return Token(TOK_CHAR, value, start);
 }
 
 Token Lexer::readString() {
     string value;
-    int startLine = line, startCol = column;
+    size_t start = base + pos;
     
     advance(); // skip opening "
     value += '"';
     
-    while (pos < input.length() && peek() != '"') {
+    while (available(1) && peek() != '"') {
         value += advance();
     }
     
-    if (pos < input.length() && peek() == '"') {
+    if (available(1) && peek() == '"') {
         value += advance(); // include closing "
     }
     
-    return Token(TOK_STRING, value, startLine, startCol);
+    return Token(TOK_STRING, value, start);
 }
 
 Token Lexer::nextToken() {
-    while (pos < input.length()) {
+    keep = string::npos;
+    while (available(1)) {
         skipWhitespace();
         
-        if (pos >= input.length()) break;
+        if (!available(1)) break;
         
         char c = peek();
+        size_t start = base + pos;
         
         // Handle comments
         if (c == '#' || c == '{') {
             skipComment();
             continue;
         }
+        keep = start;
         
         // Handle newlines
         if (c == '\n') {
-            Token tok(TOK_NEWLINE, "\\n", line, column);
+            Token tok(TOK_NEWLINE, "\\n", start);
             advance();
             return tok;
         }
@@ -199,35 +263,35 @@ Token Lexer::nextToken() {
         if (c == ':' && peek(1) == '=') {
             if (peek(2) == ':') {
                 advance(); advance(); advance();
-                return Token(TOK_SWAP, ":=:", line, column - 3);
+                return Token(TOK_SWAP, ":=:", start);
             } else {
                 advance(); advance();
-                return Token(TOK_ASSIGN, ":=", line, column - 2);
+                return Token(TOK_ASSIGN, ":=", start);
             }
         }
         
         if (c == '<' && peek(1) == '=') {
             advance(); advance();
-            return Token(TOK_LESS_EQUAL, "<=", line, column - 2);
+            return Token(TOK_LESS_EQUAL, "<=", start);
         }
         
         if (c == '>' && peek(1) == '=') {
             advance(); advance();
-            return Token(TOK_GREATER_EQUAL, ">=", line, column - 2);
+            return Token(TOK_GREATER_EQUAL, ">=", start);
         }
         
         if (c == '<' && peek(1) == '>') {
             advance(); advance();
-            return Token(TOK_NOT_EQUAL, "<>", line, column - 2);
+            return Token(TOK_NOT_EQUAL, "<>", start);
         }
         
         if (c == '.' && peek(1) == '.') {
             advance(); advance();
-            return Token(TOK_DOTS, "..", line, column - 2);
+            return Token(TOK_DOTS, "..", start);
         }
         
         // Handle single-character operators and punctuation
-        Token tok(TOK_UNKNOWN, string(1, c), line, column);
+        Token tok(TOK_UNKNOWN, string(1, c), start);
         advance();
         
         switch (c) {
@@ -252,5 +316,5 @@ Token Lexer::nextToken() {
         return tok;
     }
     
-    return Token(TOK_EOF, "", line, column);
+    return Token(TOK_EOF, "", base + pos);
 }
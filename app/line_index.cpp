@@ -0,0 +1,29 @@
+#include "line_index.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+LineIndex::LineIndex(const string& text) {
+    lineStarts.push_back(0);
+
+    // memchr is vectorized by the C library, which makes this a fast scan
+    const char* data = text.data();
+    const char* end = data + text.size();
+    const char* p = data;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (!nl) break;
+        lineStarts.push_back(nl + 1 - data);
+        p = nl + 1;
+    }
+}
+
+int LineIndex::line(size_t offset) const {
+    // Last line start not after offset
+    return (int)(upper_bound(lineStarts.begin(), lineStarts.end(), offset) - lineStarts.begin());
+}
+
+int LineIndex::column(size_t offset) const {
+    return (int)(offset - lineStarts[line(offset) - 1]) + 1;
+}
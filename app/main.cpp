@@ -1,52 +1,557 @@
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <memory>
+#include <unistd.h>
 #include "parser.h"
+#include "source_files.h"
+#include "table_parser.h"
+#include "parallel_lexer.h"
+#include "line_index.h"
+#include "token_ring.h"
+#include "parse_daemon.h"
+#include "golden_verifier.h"
+#include "json_writer.h"
+#include "ast_index.h"
+#include "node_interner.h"
+#include "node_arena.h"
+#include "memory_profiler.h"
+#include "tree_stats.h"
+#include "parallel_printer.h"
+#include "cfg_builder.h"
+#include "call_graph.h"
+#include "clone_detector.h"
+#include "tree_bundle.h"
+#include "lazy_bodies.h"
+#include "nary_chains.h"
+#include "symbols.h"
+#include "c_emitter.h"
+#include "interpreter.h"
+#include "trace.h"
+#include "inliner.h"
+
+static void usage(const char* program) {
+    std::cerr << "Usage: " << program << " [-j <threads>] [-pipe|-ll1|-lazy] [-flat] [-dag] [-inline-calls] [-time] [-trace <file>] [limits] -ast|-json|-lex|-stats|-memstats|-cfg|-calls|-prune|-signatures|-emit-c|-run <filename>\n"
+              << "       " << program << " [-time] -query <pattern> <filename>\n"
+              << "       " << program << " [-j <threads>] [-flat] -verify <directory>\n"
+              << "       " << program << " [-j <threads>] [-min-size <n>] -clones <directory>\n"
+              << "       " << program << " [-j <threads>] -bundle <archive> -ast|-json <directory>\n"
+              << "       " << program << " -extract <archive> [<path>]\n"
+              << "       " << program << " [-j <workers>] [limits] -daemon <socket>\n"
+              << "       " << program << " -client <socket> [-inline] -ast <filename>\n"
+              << "       " << program << " -client <socket> -stats\n"
+              << "A <filename> of - streams standard input through a bounded lexer window.\n"
+              << "-ll1 parses with the table-driven LL(1) engine instead of recursive descent.\n"
+              << "-lazy skips function bodies during the parse and parses them only when needed.\n"
+              << "-flat builds each chain of one of + * and or as a single n-ary node.\n"
+              << "-inline-calls [-inline-size <n>] substitutes pure helper functions of at most <n> body nodes\n"
+              << "  (default " << Inliner::DEFAULT_MAX_SIZE << ") at their call sites and reports the change on stderr.\n"
+              << "-memstats [-sample <n>] reports AST memory by node kind, tracking one node in n.\n"
+              << "-trace <file> writes a Chrome trace-event timeline of the run to <file>.\n"
+              << "Limits: -max-depth <n> (default " << ParseLimits::DEFAULT_MAX_DEPTH
+              << ", 0 for none), -max-nodes <n>, -max-bytes <n>" << std::endl;
+}
+
+// Writes the trace when main returns, after every span in it has closed
+class TraceWriter {
+public:
+    explicit TraceWriter(const std::string& file) : path(file) {
+        if (!path.empty()) Tracer::enable();
+    }
+    ~TraceWriter() {
+        if (!path.empty() && !Tracer::write(path)) {
+            std::cerr << "Error: Cannot write trace " << path << std::endl;
+        }
+    }
+private:
+    std::string path;
+};
+
+// Only recursive descent can skip function bodies or build n-ary chains
+// as it goes
+static void configure(Parser& parser, LazyBodies* bodies, bool flat) {
+    if (bodies) {
+        parser.deferBodies(bodies);
+        bodies->setFlattenChains(flat);
+    }
+    parser.setFlattenChains(flat);
+}
+
+static void configure(TableParser&, LazyBodies*, bool) {}
+
+// Parses the input with either parser, parallelizing lexing when requested.
+// Standard input is streamed through the lexer instead of being read first.
+template <class ParserType>
+static ASTNode* parseWith(const std::string& input, bool streaming, unsigned threads, const ParseLimits& limits,
+                          LazyBodies* bodies, bool flat) {
+    if (streaming) {
+        ParserType parser(std::cin);
+        parser.setLimits(limits);
+        configure(parser, nullptr, flat);
+        return parser.parseProgram();
+    }
+    if (threads > 1) {
+        ParserType parser(ParallelLexer(input, threads).tokenize());
+        parser.setLimits(limits);
+        configure(parser, bodies, flat);
+        return parser.parseProgram();
+    }
+    ParserType parser(input);
+    parser.setLimits(limits);
+    configure(parser, bodies, flat);
+    return parser.parseProgram();
+}
+
+static ASTNode* parseInput(const std::string& input, bool streaming, bool pipelined, bool table, unsigned threads,
+                           const ParseLimits& limits, LazyBodies* bodies, bool flat) {
+    ASTNode* ast;
+    if (table) {
+        ast = parseWith<TableParser>(input, streaming, threads, limits, bodies, flat);
+    } else if (pipelined && !streaming) {
+        ast = PipelinedParse(input, limits).parseProgram();
+    } else {
+        return parseWith<Parser>(input, streaming, threads, limits, bodies, flat);
+    }
+    // These parsers build binary chains, so fold them afterwards
+    if (ast && flat) flattenChains(ast);
+    return ast;
+}
 
 int main(int argc, char* argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " -ast <filename>" << std::endl;
-        return 1;
+    std::string flag;
+    std::string filename;
+    std::string socketPath;
+    std::string pattern;
+    std::string tracePath;
+    std::string bundlePath;
+    unsigned threads = 0;
+    bool pipelined = false;
+    bool table = false;
+    bool lazy = false;
+    bool flat = false;
+    bool inlineCalls = false;
+    size_t inlineSize = Inliner::DEFAULT_MAX_SIZE;
+    unsigned sampleRate = 1;
+    size_t minCloneSize = CloneDetector::DEFAULT_MIN_SIZE;
+    bool shared = false;
+    ParseLimits limits;
+    bool timed = false;
+    bool client = false;
+    bool inlineSource = false;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threads = (unsigned)std::atoi(argv[++i]);
+        } else if (arg == "-max-depth" && i + 1 < argc) {
+            limits.maxDepth = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-max-nodes" && i + 1 < argc) {
+            limits.maxNodes = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-max-bytes" && i + 1 < argc) {
+            limits.maxArenaBytes = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-pipe") {
+            pipelined = true;
+        } else if (arg == "-ll1") {
+            table = true;
+        } else if (arg == "-lazy") {
+            lazy = true;
+        } else if (arg == "-flat") {
+            flat = true;
+        } else if (arg == "-inline-calls") {
+            inlineCalls = true;
+        } else if (arg == "-inline-size" && i + 1 < argc) {
+            inlineSize = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-sample" && i + 1 < argc) {
+            sampleRate = (unsigned)std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-min-size" && i + 1 < argc) {
+            minCloneSize = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-dag") {
+            shared = true;
+        } else if (arg == "-trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (arg == "-bundle" && i + 1 < argc) {
+            bundlePath = argv[++i];
+        } else if (arg == "-time") {
+            timed = true;
+        } else if (arg == "-client" && i + 1 < argc) {
+            client = true;
+            socketPath = argv[++i];
+        } else if (arg == "-inline") {
+            inlineSource = true;
+        } else if (arg == "-ast" || arg == "-json" || arg == "-lex" || arg == "-emit-c" || arg == "-run" ||
+                   arg == "-cfg" || arg == "-calls" || arg == "-prune" || arg == "-signatures" ||
+                   arg == "-stats" || arg == "-memstats" || arg == "-verify" || arg == "-clones" || (arg == "-daemon" && i + 1 < argc) ||
+                   (arg == "-extract" && i + 1 < argc) ||
+                   (arg == "-query" && i + 1 < argc)) {
+            if (!flag.empty()) {
+                usage(argv[0]);
+                return 1;
+            }
+            flag = arg;
+            if (arg == "-daemon") socketPath = argv[++i];
+            if (arg == "-extract") bundlePath = argv[++i];
+            if (arg == "-query") pattern = argv[++i];
+        } else if (filename.empty() && (arg[0] != '-' || arg == "-")) {
+            filename = arg;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
     }
     
-    std::string flag = argv[1];
-    std::string filename = argv[2];
+    TraceWriter traceWriter(tracePath);
     
-    if (flag != "-ast") {
-        std::cerr << "Only -ast flag is supported" << std::endl;
-        return 1;
+    if (flag == "-daemon") {
+        unsigned workers = threads ? threads : std::thread::hardware_concurrency();
+        return ParseDaemon(socketPath, workers, limits).run();
     }
     
-    // Read input file
-    std::ifstream file(filename);
-    if (!file.is_open()) {
-        std::cerr << "Error: Cannot open file " << filename << std::endl;
-        return 1;
+    if (flag == "-verify" && !filename.empty()) {
+        // Compare every <file> in the directory with its <file>.tree golden
+        std::vector<GoldenCase> cases = GoldenVerifier::discover(filename);
+        if (cases.empty()) {
+            std::cerr << "Error: no golden pairs found in " << filename << std::endl;
+            return 1;
+        }
+        unsigned workers = threads ? threads : std::thread::hardware_concurrency();
+        GoldenVerifier verifier(cases, workers);
+        verifier.setFlattenChains(flat);
+        return verifier.run(std::cout) == 0 ? 0 : 1;
     }
     
-    std::string input;
-    std::string line;
-    while (getline(file, line)) {
-        input += line + "\n";
+    if (flag == "-clones" && !filename.empty()) {
+        // Copy-pasted subtrees across every file under the directory
+        std::vector<std::string> files = findSourceFiles(filename);
+        if (files.empty()) {
+            std::cerr << "Error: no files found in " << filename << std::endl;
+            return 1;
+        }
+        unsigned workers = threads ? threads : std::thread::hardware_concurrency();
+        std::chrono::steady_clock::time_point indexStart = std::chrono::steady_clock::now();
+        CloneDetector detector(files, minCloneSize, workers);
+        detector.run();
+        if (timed) {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - indexStart;
+            std::cerr << "index: " << elapsed.count() << " ms" << std::endl;
+        }
+        detector.report(std::cout);
+        return 0;
+    }
+    
+    if (!bundlePath.empty() && (flag == "-ast" || flag == "-json") && !filename.empty()) {
+        // Every tree under the directory in one archive, instead of a file each
+        std::vector<std::string> files = findSourceFiles(filename);
+        if (files.empty()) {
+            std::cerr << "Error: no files found in " << filename << std::endl;
+            return 1;
+        }
+        unsigned workers = threads ? threads : std::thread::hardware_concurrency();
+        try {
+            size_t bundled = writeBundle(files, bundlePath, flag == "-json" ? BUNDLE_JSON : BUNDLE_TEXT, workers,
+                                         std::cerr);
+            std::cout << "bundled " << bundled << " of " << files.size() << " files into " << bundlePath << std::endl;
+            return bundled == files.size() ? 0 : 1;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    
+    if (flag == "-extract") {
+        // One tree from an archive, or the list of what it holds
+        try {
+            BundleReader bundle(bundlePath);
+            BundleReader::Entry entry;
+            if (filename.empty()) {
+                for (size_t i = 0; i < bundle.size(); i++) {
+                    entry = bundle.entry(i);
+                    std::cout << entry.path << " " << entry.length << "\n";
+                }
+                return 0;
+            }
+            if (!bundle.find(filename, entry)) {
+                std::cerr << "Error: " << filename << " is not in " << bundlePath << std::endl;
+                return 1;
+            }
+            if (bundleHash(entry.data, entry.length) != entry.hash) {
+                std::cerr << "Error: tree of " << filename << " is corrupt" << std::endl;
+                return 1;
+            }
+            std::cout.write(entry.data, entry.length);
+            return 0;
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
     }
-    file.close();
     
+    if (client) {
+        if (flag == "-stats") return runParseClient(socketPath, "STATS", "");
+        if (flag != "-ast" || filename.empty()) {
+            usage(argv[0]);
+            return 1;
+        }
+        if (inlineSource) {
+            std::string source;
+            try {
+                if (!readSourceFile(filename, source)) {
+                    std::cerr << "Error: Cannot open file " << filename << std::endl;
+                    return 1;
+                }
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+            return runParseClient(socketPath, "SOURCE " + std::to_string(source.size()), source);
+        }
+        // The daemon may run in another directory
+        char* resolved = realpath(filename.c_str(), nullptr);
+        if (!resolved) {
+            std::cerr << "Error: Cannot open file " << filename << std::endl;
+            return 1;
+        }
+        std::string absolute = resolved;
+        free(resolved);
+        return runParseClient(socketPath, "PARSE " + absolute, "");
+    }
+    
+    if (flag.empty() || filename.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (threads == 0) threads = 1;
+    
+    // Read input file, unless it is streamed from standard input
+    bool streaming = filename == "-";
+    if (streaming && flag == "-run") {
+        std::cerr << "Error: -run reads program input from stdin, so the program must be a file" << std::endl;
+        return 1;
+    }
+    Tracer::FileScope traced(filename);
+    if (flag == "-signatures") lazy = true;
+    if (lazy && (streaming || pipelined || table)) {
+        std::cerr << "Error: -lazy needs the recursive-descent parser and a file to come back to" << std::endl;
+        return 1;
+    }
+    std::string input;
     try {
-        // Parse the input
-        Parser parser(input);
-        ASTNode* ast = parser.parseProgram();
-        
-        if (ast) {
-            // Print the AST
-            ast->print(0, true);
-            std::cout << std::endl; // Add final newline to match expected output
-        } else {
+        if (!streaming) {
+            TraceSpan span("read", "io");
+            if (!readSourceFile(filename, input)) {
+                std::cerr << "Error: Cannot open file " << filename << std::endl;
+                return 1;
+            }
+        }
+        
+        if (flag == "-lex" && streaming) {
+            // Same dump in constant memory
+            Lexer lexer(std::cin);
+            int line, column;
+            for (Token tok = lexer.nextToken();; tok = lexer.nextToken()) {
+                lexer.locate(tok.offset, line, column);
+                std::cout << line << ":" << column << " " << tok.type << " " << tok.value << "\n";
+                if (tok.type == TOK_EOF) break;
+            }
+            return 0;
+        }
+        if (flag == "-lex") {
+            // Dump the token stream, one token per line
+            std::vector<Token> tokens = ParallelLexer(input, threads).tokenize();
+            LineIndex lines(input);
+            for (size_t i = 0; i < tokens.size(); i++) {
+                const Token& tok = tokens[i];
+                std::cout << lines.line(tok.offset) << ":" << lines.column(tok.offset) << " " << tok.type
+                          << " " << tok.value << "\n";
+            }
+            return 0;
+        }
+        
+        std::chrono::steady_clock::time_point parseStart = std::chrono::steady_clock::now();
+        NodeArena arena; // owns the tree and enforces the node and byte budgets
+        arena.setLimits(limits);
+        NodeInterner interner;
+        MemoryProfiler profiler(sampleRate);
+        LazyBodies bodies(input);
+        bodies.setLimits(limits);
+        ASTNode* ast;
+        {
+            TraceSpan span("parse", "parse");
+            NodeArena::Scope arenaScope(arena);
+            std::unique_ptr<MemoryProfiler::Scope> profiling;
+            if (flag == "-memstats") profiling.reset(new MemoryProfiler::Scope(profiler));
+            if (shared) {
+                // Build a DAG in which identical subtrees are allocated once
+                NodeInterner::Scope scope(interner);
+                ast = parseInput(input, streaming, pipelined, table, threads, limits, lazy ? &bodies : nullptr, flat);
+            } else {
+                ast = parseInput(input, streaming, pipelined, table, threads, limits, lazy ? &bodies : nullptr, flat);
+            }
+        }
+        if (timed) {
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - parseStart;
+            std::cerr << "parse: " << elapsed.count() << " ms" << std::endl;
+        }
+        
+        if (!ast) {
             std::cerr << "Parse error" << std::endl;
             return 1;
         }
         
-        // Clean up memory (in practice, you'd want proper RAII)
-        delete ast;
+        if (flag == "-signatures") {
+            // Names, parameters and return types; the bodies were never parsed
+            printSignatures(ast, std::cout);
+            return 0;
+        }
+        
+        if (lazy) {
+            // Everything else reads the bodies, so parse them all now
+            std::chrono::steady_clock::time_point bodiesStart = std::chrono::steady_clock::now();
+            NodeArena::Scope arenaScope(arena);
+            std::unique_ptr<MemoryProfiler::Scope> profiling;
+            if (flag == "-memstats") profiling.reset(new MemoryProfiler::Scope(profiler));
+            // Bodies join the same DAG as the skeleton
+            std::unique_ptr<NodeInterner::Scope> interning;
+            if (shared) interning.reset(new NodeInterner::Scope(interner));
+            bodies.materializeAll(ast);
+            if (timed) {
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - bodiesStart;
+                std::cerr << "bodies: " << elapsed.count() << " ms" << std::endl;
+            }
+        }
+        
+        if (timed && shared) {
+            // Counted once every body is in the tree
+            std::cerr << "dag: " << interner.uniqueCount() << " unique of " << interner.internedCount()
+                      << " nodes" << std::endl;
+        }
+        
+        if (flat && (flag == "-cfg" || flag == "-emit-c" || flag == "-run")) {
+            // These read operators as binary, so restore the canonical tree
+            NodeArena::Scope arenaScope(arena);
+            expandChains(ast);
+        }
+        
+        if (flag == "-memstats") {
+            // Memory by node kind, as accounted during the parse
+            profiler.report(std::cout);
+            return 0;
+        }
+        
+        if (inlineCalls) {
+            // Expand small helper calls in place before the mode reads the tree
+            std::chrono::steady_clock::time_point inlineStart = std::chrono::steady_clock::now();
+            NodeArena::Scope arenaScope(arena);
+            Inliner inliner(inlineSize);
+            ast = inliner.run(ast);
+            if (timed) {
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - inlineStart;
+                std::cerr << "inline: " << elapsed.count() << " ms" << std::endl;
+            }
+            inliner.report(std::cerr);
+        }
+        
+        if (flag == "-calls" || flag == "-prune") {
+            // Reachability from the main block over the function call graph
+            std::chrono::steady_clock::time_point graphStart = std::chrono::steady_clock::now();
+            std::unique_ptr<TraceSpan> span(new TraceSpan("call graph", "semantic"));
+            CallGraph graph = buildCallGraph(ast, threads);
+            std::vector<char> reachable = reachableFunctions(graph, threads);
+            std::vector<std::vector<uint32_t> > recursive = recursiveComponents(graph);
+            span.reset();
+            if (timed) {
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - graphStart;
+                std::cerr << "calls: " << elapsed.count() << " ms" << std::endl;
+            }
+            if (flag == "-calls") {
+                printCallGraphReport(graph, reachable, recursive, std::cout);
+                return 0;
+            }
+            // -prune prints the tree without unreachable functions, as -ast would
+            NodeArena::Scope arenaScope(arena);
+            ast = pruneUnreachable(ast, graph, reachable);
+            flag = "-ast";
+        }
+        
+        if (flag == "-ast") {
+            // Print the AST, rendering subtrees on the -j workers if several
+            std::chrono::steady_clock::time_point printStart = std::chrono::steady_clock::now();
+            {
+                TraceSpan span("print", "print");
+                if (threads > 1) {
+                    std::cout.flush();
+                    printTreeParallel(ast, STDOUT_FILENO, threads);
+                } else {
+                    ast->print(0, true);
+                }
+                std::cout << std::endl; // Add final newline to match expected output
+            }
+            if (timed) {
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - printStart;
+                std::cerr << "print: " << elapsed.count() << " ms" << std::endl;
+            }
+        } else if (flag == "-json") {
+            // Stream the tree as JSON
+            TraceSpan span("print", "print");
+            writeJsonTree(ast, std::cout);
+        } else if (flag == "-stats") {
+            // Node counts per kind, category and function
+            std::chrono::steady_clock::time_point visitStart = std::chrono::steady_clock::now();
+            TreeStats stats = collectTreeStats(ast, threads);
+            if (timed) {
+                // Compare with string-comparison dispatch over the same tree
+                std::chrono::steady_clock::time_point namesStart = std::chrono::steady_clock::now();
+                size_t categories[CAT_OTHER + 1];
+                countCategoriesByName(ast, categories);
+                std::chrono::steady_clock::time_point namesEnd = std::chrono::steady_clock::now();
+                std::chrono::duration<double, std::milli> visiting = namesStart - visitStart;
+                std::chrono::duration<double, std::milli> naming = namesEnd - namesStart;
+                bool same = std::equal(categories, categories + CAT_OTHER + 1, stats.categories);
+                std::cerr << "stats: visitor " << visiting.count() << " ms, string dispatch "
+                          << naming.count() << " ms" << (same ? "" : " (counts differ)") << std::endl;
+            }
+            printTreeStats(stats, std::cout);
+        } else if (flag == "-cfg") {
+            // Basic blocks in SSA form for every function and the main block
+            ProgramInfo info(ast);
+            std::chrono::steady_clock::time_point cfgStart = std::chrono::steady_clock::now();
+            std::vector<FunctionCfg> cfgs = buildProgramCfgs(ast, info, threads);
+            if (timed) {
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - cfgStart;
+                std::cerr << "cfg: " << elapsed.count() << " ms" << std::endl;
+            }
+            for (size_t i = 0; i < cfgs.size(); i++) printCfg(cfgs[i], std::cout);
+        } else if (flag == "-query") {
+            // Print the path of every node matching the pattern
+            std::chrono::steady_clock::time_point indexStart = std::chrono::steady_clock::now();
+            AstIndex index(ast);
+            AstQuery query(pattern);
+            std::chrono::steady_clock::time_point queryStart = std::chrono::steady_clock::now();
+            std::vector<AstIndex::NodeId> matches = index.find(query);
+            if (timed) {
+                std::chrono::duration<double, std::milli> building = queryStart - indexStart;
+                std::chrono::duration<double, std::milli> querying =
+                    std::chrono::steady_clock::now() - queryStart;
+                std::cerr << "index: " << building.count() << " ms (" << index.size() << " nodes), query: "
+                          << querying.count() << " ms" << std::endl;
+            }
+            for (size_t i = 0; i < matches.size(); i++) std::cout << index.path(matches[i]) << "\n";
+        } else if (flag == "-emit-c") {
+            // Translate to a standalone C program
+            ProgramInfo info(ast);
+            TraceSpan span("emit-c", "print");
+            CEmitter emitter(std::cout, info);
+            emitter.emit(ast);
+        } else {
+            // Execute directly, reading program input from stdin
+            ProgramInfo info(ast);
+            TraceSpan span("run", "run");
+            Interpreter interpreter(ast, info);
+            interpreter.run();
+        }
         
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,161 @@
+#include "memory_profiler.h"
+#include "ast_node.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+static thread_local MemoryProfiler* activeProfiler = nullptr;
+
+// Strings up to this capacity live inside the object
+static const size_t INLINE_CAPACITY = string().capacity();
+
+MemoryProfiler::MemoryProfiler(unsigned sampleRate)
+    : rate(sampleRate ? sampleRate : 1), live(0), peak(0), pending(nullptr) {
+    memset(stats, 0, sizeof(stats));
+}
+
+bool MemoryProfiler::sampled(const void* node) const {
+    if (rate == 1) return true;
+    // Arena slots are consecutive, so mix the address before taking it apart
+    uint64_t h = (uint64_t)(uintptr_t)node * 0x9e3779b97f4a7c15ULL;
+    return (h >> 32) % rate == 0;
+}
+
+size_t MemoryProfiler::nodeBytes(const ASTNode* node) {
+    size_t bytes = sizeof(ASTNode);
+    if (node->nodeType.capacity() > INLINE_CAPACITY) bytes += node->nodeType.capacity() + 1;
+    if (node->value.capacity() > INLINE_CAPACITY) bytes += node->value.capacity() + 1;
+    return bytes;
+}
+
+void MemoryProfiler::grow(NodeKind k, long bytes) {
+    KindStats& s = stats[k];
+    s.liveBytes += bytes;
+    live += bytes;
+    if (s.liveBytes > s.peakBytes) s.peakBytes = s.liveBytes;
+    if (live > peak) peak = live;
+}
+
+// The node from the last operator new has been constructed by now, so its
+// kind and strings can be read
+void MemoryProfiler::settle() {
+    if (!pending) return;
+    const ASTNode* node = static_cast<const ASTNode*>(pending);
+    pending = nullptr;
+    if (!sampled(node)) return;
+    size_t bytes = nodeBytes(node);
+    KindStats& s = stats[node->kind];
+    s.nodes++;
+    s.nodeBytes += bytes;
+    grow(node->kind, (long)bytes);
+}
+
+void MemoryProfiler::noteNew(void* node) {
+    MemoryProfiler* profiler = activeProfiler;
+    if (!profiler) return;
+    profiler->settle();
+    profiler->pending = node;
+}
+
+void MemoryProfiler::noteDelete(void* node) {
+    MemoryProfiler* profiler = activeProfiler;
+    // A constructor threw; the node was never counted
+    if (profiler && profiler->pending == node) profiler->pending = nullptr;
+}
+
+void MemoryProfiler::noteChild(const ASTNode* parent, size_t oldCapacity) {
+    MemoryProfiler* profiler = activeProfiler;
+    if (!profiler) return;
+    profiler->settle();
+    if (!profiler->sampled(parent)) return;
+    KindStats& s = profiler->stats[parent->kind];
+    s.children++;
+    // Capacity reserved before the first child shows up with that child
+    size_t before = parent->children.size() == 1 ? 0 : oldCapacity * sizeof(ASTNode*);
+    size_t after = parent->children.capacity() * sizeof(ASTNode*);
+    if (after == before) return;
+    // The old buffer is freed only once the new one holds the children
+    s.vectorBytes += after - before;
+    profiler->grow(parent->kind, (long)after);
+    profiler->grow(parent->kind, -(long)before);
+}
+
+void MemoryProfiler::noteDiscard(const ASTNode* node) {
+    MemoryProfiler* profiler = activeProfiler;
+    if (!profiler) return;
+    profiler->settle();
+    if (!profiler->sampled(node)) return;
+    KindStats& s = profiler->stats[node->kind];
+    size_t bytes = nodeBytes(node);
+    size_t vector = node->children.capacity() * sizeof(ASTNode*);
+    s.nodes--;
+    s.nodeBytes -= bytes;
+    s.children -= node->children.size();
+    s.vectorBytes -= vector;
+    profiler->grow(node->kind, -(long)(bytes + vector));
+}
+
+MemoryProfiler::KindStats MemoryProfiler::kind(NodeKind k) const {
+    KindStats s = stats[k];
+    s.nodes *= rate;
+    s.nodeBytes *= rate;
+    s.children *= rate;
+    s.vectorBytes *= rate;
+    s.liveBytes *= rate;
+    s.peakBytes *= rate;
+    return s;
+}
+
+void MemoryProfiler::report(ostream& out) {
+    settle();
+    vector<NodeKind> kinds;
+    for (int k = 0; k < NK_KIND_COUNT; k++) {
+        if (stats[k].nodes || stats[k].peakBytes) kinds.push_back((NodeKind)k);
+    }
+    // Largest consumers first
+    sort(kinds.begin(), kinds.end(), [this](NodeKind a, NodeKind b) {
+        return stats[a].nodeBytes + stats[a].vectorBytes > stats[b].nodeBytes + stats[b].vectorBytes;
+    });
+
+    if (rate > 1) out << "sampled 1 node in " << rate << "; figures are scaled estimates\n";
+    char line[160];
+    snprintf(line, sizeof(line), "%-14s %10s %12s %7s %12s %12s %12s\n", "kind", "nodes", "node bytes", "fan-out",
+             "vector bytes", "vector waste", "peak bytes");
+    out << line;
+    KindStats total;
+    memset(&total, 0, sizeof(total));
+    for (size_t i = 0; i < kinds.size(); i++) {
+        KindStats s = kind(kinds[i]);
+        // Capacity beyond the children actually held
+        size_t waste = s.vectorBytes - s.children * sizeof(ASTNode*);
+        snprintf(line, sizeof(line), "%-14s %10zu %12zu %7.2f %12zu %12zu %12zu\n", nodeKindName(kinds[i]), s.nodes,
+                 s.nodeBytes, s.nodes ? (double)s.children / s.nodes : 0.0, s.vectorBytes, waste, s.peakBytes);
+        out << line;
+        total.nodes += s.nodes;
+        total.nodeBytes += s.nodeBytes;
+        total.children += s.children;
+        total.vectorBytes += s.vectorBytes;
+    }
+    snprintf(line, sizeof(line), "%-14s %10zu %12zu %7.2f %12zu %12zu %12s\n", "total", total.nodes, total.nodeBytes,
+             total.nodes ? (double)total.children / total.nodes : 0.0, total.vectorBytes,
+             total.vectorBytes - total.children * sizeof(ASTNode*), "");
+    out << line;
+    out << "peak live: " << peakBytes() << " bytes\n";
+}
+
+MemoryProfiler* MemoryProfiler::active() {
+    return activeProfiler;
+}
+
+MemoryProfiler::Scope::Scope(MemoryProfiler& profiler) : previous(activeProfiler) {
+    activeProfiler = &profiler;
+}
+
+MemoryProfiler::Scope::~Scope() {
+    activeProfiler = previous;
+}
@@ -0,0 +1,211 @@
+// Component microbenchmarks: each stage of winzigc measured in isolation
+// on a preloaded input, with hardware counters where the kernel allows
+// them. Built by `make microbench`; not part of winzigc itself.
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <sched.h>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "lexer.h"
+#include "source_files.h"
+#include "parser.h"
+#include "table_parser.h"
+#include "node_arena.h"
+#include "perf_counters.h"
+
+using namespace std;
+
+// Swallows everything, so printing costs only the formatting
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) { return c == EOF ? 0 : c; }
+    streamsize xsputn(const char*, streamsize count) { return count; }
+};
+
+struct Benchmark {
+    const char* name;
+    size_t items;            // work per run, for the per-item column
+    const char* unit;
+    function<void()> prepare; // untimed, before each run
+    function<void()> run;
+    function<void()> finish;  // untimed, after each run
+};
+
+static double median(vector<double> values) {
+    sort(values.begin(), values.end());
+    size_t n = values.size();
+    return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+// Median absolute deviation as a fraction of the median
+static double spread(const vector<double>& values) {
+    double center = median(values);
+    vector<double> deviations;
+    for (size_t i = 0; i < values.size(); i++) deviations.push_back(values[i] > center ? values[i] - center : center - values[i]);
+    return center > 0 ? median(deviations) / center : 0;
+}
+
+static const size_t WARMUP_RUNS = 2;
+static const double STABLE_SPREAD = 0.02;
+
+// Runs a benchmark at least minSamples times, taking up to four times as
+// many while the wall-time medians still wander by more than 2%
+static void measure(const Benchmark& bench, PerfCounters& counters, size_t minSamples) {
+    for (size_t i = 0; i < WARMUP_RUNS; i++) {
+        bench.prepare();
+        bench.run();
+        bench.finish();
+    }
+
+    vector<double> samples[1 + PerfCounters::COUNTER_COUNT]; // wall ns, then counters
+    while (true) {
+        bench.prepare();
+        counters.start();
+        bench.run();
+        PerfCounters::Sample sample = counters.stop();
+        bench.finish();
+
+        samples[0].push_back(sample.wallNs);
+        for (int c = 0; c < PerfCounters::COUNTER_COUNT; c++) samples[1 + c].push_back((double)sample.values[c]);
+        size_t taken = samples[0].size();
+        if (taken >= minSamples && (spread(samples[0]) <= STABLE_SPREAD || taken >= 4 * minSamples)) break;
+    }
+
+    double wall = median(samples[0]);
+    printf("%-13s %9.3f %5.1f%% %3zu %9.1f ns/%-5s", bench.name, wall / 1e6, spread(samples[0]) * 100,
+           samples[0].size(), bench.items ? wall / bench.items : 0.0, bench.unit);
+    for (int c = 0; c < PerfCounters::COUNTER_COUNT; c++) {
+        if (counters.available((PerfCounters::Counter)c)) {
+            printf(" %14.0f", median(samples[1 + c]));
+        } else {
+            printf(" %14s", "-");
+        }
+    }
+    if (counters.available(PerfCounters::CYCLES) && counters.available(PerfCounters::INSTRUCTIONS)) {
+        double cycles = median(samples[1 + PerfCounters::CYCLES]);
+        printf(" %5.2f", cycles > 0 ? median(samples[1 + PerfCounters::INSTRUCTIONS]) / cycles : 0.0);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+// Rebuilds a copy of a parsed tree, allocating and linking nodes the way
+// the parser does but without lexing or grammar decisions
+static ASTNode* copyTree(const ASTNode* node) {
+    ASTNode* copy = new ASTNode(node->nodeType, node->kind);
+    copy->value = node->value;
+    for (size_t i = 0; i < node->children.size(); i++) copy->addChild(copyTree(node->children[i]));
+    return copy;
+}
+
+static size_t countNodes(const ASTNode* node) {
+    size_t count = 1;
+    for (size_t i = 0; i < node->children.size(); i++) count += countNodes(node->children[i]);
+    return count;
+}
+
+static void usage(const char* program) {
+    cerr << "Usage: " << program << " [-n <samples>] <filename>" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    size_t minSamples = 15;
+    string filename;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-n" && i + 1 < argc) {
+            minSamples = strtoul(argv[++i], nullptr, 10);
+        } else if (filename.empty() && arg[0] != '-') {
+            filename = arg;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filename.empty() || minSamples == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    string input;
+    if (!readSourceFile(filename, input)) {
+        cerr << "Error: Cannot open file " << filename << endl;
+        return 1;
+    }
+
+    // Stay on one CPU so migrations do not show up as noise
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    int cpu = sched_getcpu();
+    if (cpu >= 0) {
+        CPU_SET(cpu, &cpus);
+        sched_setaffinity(0, sizeof(cpus), &cpus);
+    }
+
+    try {
+        // Shared inputs for the stages after lexing
+        vector<Token> tokens;
+        Lexer counting(input);
+        do {
+            tokens.push_back(counting.nextToken());
+        } while (tokens.back().type != TOK_EOF);
+
+        NodeArena treeArena;
+        ASTNode* tree;
+        {
+            NodeArena::Scope scope(treeArena);
+            tree = Parser(tokens).parseProgram();
+        }
+        size_t nodes = countNodes(tree);
+
+        NodeArena arena;
+        NullBuffer nullBuffer;
+        ostream nullSink(&nullBuffer);
+        Lexer* lexer = nullptr;
+        Parser* parser = nullptr;
+        TableParser* tableParser = nullptr;
+        NodeArena::Scope* scope = nullptr;
+
+        Benchmark benchmarks[] = {
+            {"lex", tokens.size(), "token",
+             [&]() { lexer = new Lexer(input); },
+             [&]() { while (lexer->nextToken().type != TOK_EOF) {} },
+             [&]() { delete lexer; }},
+            {"parse-tokens", tokens.size(), "token",
+             [&]() { parser = new Parser(tokens); scope = new NodeArena::Scope(arena); },
+             [&]() { parser->parseProgram(); },
+             [&]() { delete scope; delete parser; arena.reset(); }},
+            {"parse-ll1", tokens.size(), "token",
+             [&]() { tableParser = new TableParser(tokens); scope = new NodeArena::Scope(arena); },
+             [&]() { tableParser->parseProgram(); },
+             [&]() { delete scope; delete tableParser; arena.reset(); }},
+            {"build-tree", nodes, "node",
+             [&]() { scope = new NodeArena::Scope(arena); },
+             [&]() { copyTree(tree); },
+             [&]() { delete scope; arena.reset(); }},
+            {"print", nodes, "node",
+             [&]() {},
+             [&]() { tree->print(0, true, nullSink); },
+             [&]() {}},
+        };
+
+        PerfCounters counters;
+        printf("input: %s, %zu bytes, %zu tokens, %zu nodes\n", filename.c_str(), input.size(), tokens.size(), nodes);
+        if (!counters.anyAvailable()) {
+            printf("hardware counters unavailable (%s); wall time only\n", counters.unavailableReason().c_str());
+        }
+        printf("%-13s %9s %6s %3s %18s", "benchmark", "ms", "mad", "n", "per item");
+        for (int c = 0; c < PerfCounters::COUNTER_COUNT; c++) printf(" %14s", PerfCounters::name((PerfCounters::Counter)c));
+        if (counters.available(PerfCounters::CYCLES) && counters.available(PerfCounters::INSTRUCTIONS)) printf(" %5s", "ipc");
+        printf("\n");
+        for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) measure(benchmarks[i], counters, minSamples);
+    } catch (const exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include "nary_chains.h"
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+// Both rewrites walk with an explicit stack, since the binary side of a
+// chain can be far deeper than the C++ stack allows. Shared subtrees (see
+// NodeInterner) are rewritten once.
+
+static bool sameChain(const ASTNode* node, const ASTNode* operand) {
+    return operand->kind == node->kind && operand->nodeType == node->nodeType && operand->children.size() == 2;
+}
+
+size_t flattenChains(ASTNode* root) {
+    size_t folded = 0;
+    vector<ASTNode*> stack(1, root);
+    unordered_set<const ASTNode*> seen;
+    while (!stack.empty()) {
+        ASTNode* node = stack.back();
+        stack.pop_back();
+        if (!seen.insert(node).second) continue;
+        if (isAssociative(node->kind) && node->children.size() == 2 && sameChain(node, node->children[0])) {
+            // Right operands from the top of the spine down, then the leftmost
+            vector<ASTNode*> operands(1, node->children[1]);
+            const ASTNode* spine = node->children[0];
+            while (sameChain(node, spine)) {
+                operands.push_back(spine->children[1]);
+                spine = spine->children[0];
+                folded++;
+            }
+            operands.push_back(const_cast<ASTNode*>(spine));
+            reverse(operands.begin(), operands.end());
+            node->children.swap(operands);
+        }
+        for (size_t i = 0; i < node->children.size(); i++) stack.push_back(node->children[i]);
+    }
+    return folded;
+}
+
+size_t expandChains(ASTNode* root) {
+    size_t added = 0;
+    vector<ASTNode*> stack(1, root);
+    unordered_set<const ASTNode*> seen;
+    while (!stack.empty()) {
+        ASTNode* node = stack.back();
+        stack.pop_back();
+        if (!seen.insert(node).second) continue;
+        for (size_t i = 0; i < node->children.size(); i++) stack.push_back(node->children[i]);
+        if (!isAssociative(node->kind) || node->children.size() <= 2) continue;
+
+        // The node itself stays the top of the chain
+        ASTNode* left = node->children[0];
+        for (size_t i = 1; i + 1 < node->children.size(); i++) {
+            ASTNode* level = new ASTNode(node->nodeType, node->kind);
+            level->addChild(left);
+            level->addChild(node->children[i]);
+            seen.insert(level);
+            left = level;
+            added++;
+        }
+        vector<ASTNode*> pair;
+        pair.push_back(left);
+        pair.push_back(node->children.back());
+        node->children.swap(pair);
+    }
+    return added;
+}
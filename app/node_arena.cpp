@@ -0,0 +1,75 @@
+#include "node_arena.h"
+#include "ast_node.h"
+#include <new>
+#include <string>
+
+using namespace std;
+
+static thread_local NodeArena* activeArena = nullptr;
+
+NodeArena::NodeArena(size_t nodesPerBlock)
+    : slotBytes((sizeof(ASTNode) + alignof(ASTNode) - 1) / alignof(ASTNode) * alignof(ASTNode)),
+      blockBytes(slotBytes * nodesPerBlock), slotsPerBlock(nodesPerBlock), count(0),
+      maxNodes(0), maxBytes(0) {}
+
+NodeArena::~NodeArena() {
+    reset();
+    for (size_t i = 0; i < blocks.size(); i++) ::operator delete(blocks[i]);
+}
+
+void* NodeArena::allocate(size_t bytes) {
+    if (bytes > slotBytes) throw bad_alloc();
+    if (maxNodes && count >= maxNodes) {
+        throw ResourceLimitError("node budget of " + to_string(maxNodes) + " exceeded");
+    }
+
+    size_t block = count / slotsPerBlock;
+    if (block == blocks.size()) {
+        if (maxBytes && (blocks.size() + 1) * blockBytes > maxBytes) {
+            throw ResourceLimitError("arena budget of " + to_string(maxBytes) + " bytes exceeded");
+        }
+        blocks.push_back(static_cast<char*>(::operator new(blockBytes)));
+    }
+    void* slot = blocks[block] + (count % slotsPerBlock) * slotBytes;
+    count++;
+    return slot;
+}
+
+bool NodeArena::releaseLast(void* p) {
+    if (!isLast(p)) return false;
+    count--;
+    return true;
+}
+
+bool NodeArena::isLast(const void* p) const {
+    if (count == 0) return false;
+    size_t last = count - 1;
+    return p == blocks[last / slotsPerBlock] + (last % slotsPerBlock) * slotBytes;
+}
+
+void NodeArena::reset() {
+    // Every slot holds a constructed ASTNode; run their destructors so the
+    // strings and child vectors they own are released
+    for (size_t i = 0; i < count; i++) {
+        char* slot = blocks[i / slotsPerBlock] + (i % slotsPerBlock) * slotBytes;
+        reinterpret_cast<ASTNode*>(slot)->~ASTNode();
+    }
+    count = 0;
+}
+
+void NodeArena::setLimits(const ParseLimits& limits) {
+    maxNodes = limits.maxNodes;
+    maxBytes = limits.maxArenaBytes;
+}
+
+NodeArena* NodeArena::active() {
+    return activeArena;
+}
+
+NodeArena::Scope::Scope(NodeArena& arena) : previous(activeArena) {
+    activeArena = &arena;
+}
+
+NodeArena::Scope::~Scope() {
+    activeArena = previous;
+}
@@ -0,0 +1,105 @@
+#include "node_interner.h"
+#include "node_arena.h"
+#include "memory_profiler.h"
+#include <functional>
+
+using namespace std;
+
+static thread_local NodeInterner* activeInterner = nullptr;
+
+static size_t combine(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+static size_t structuralHash(const ASTNode* node) {
+    hash<string> text;
+    size_t h = combine(text(node->nodeType), text(node->value));
+    for (size_t i = 0; i < node->children.size(); i++) {
+        h = combine(h, node->children[i]->structuralHash);
+    }
+    // Zero marks a node that was never interned
+    return h ? h : 1;
+}
+
+static bool sameShape(const ASTNode* a, const ASTNode* b) {
+    return a->structuralHash == b->structuralHash && a->kind == b->kind && a->nodeType == b->nodeType && a->value == b->value &&
+           a->children == b->children;
+}
+
+NodeInterner::NodeInterner() : slots(1024, nullptr), interned(0), unique(0) {}
+
+NodeInterner::~NodeInterner() {}
+
+ASTNode* NodeInterner::intern(ASTNode* node) {
+    if (node->structuralHash) return node; // already canonical
+    interned++;
+    node->structuralHash = structuralHash(node);
+
+    size_t mask = slots.size() - 1;
+    for (size_t i = node->structuralHash & mask;; i = (i + 1) & mask) {
+        ASTNode* existing = slots[i];
+        if (!existing) {
+            slots[i] = node;
+            if (++unique * 2 > slots.size()) grow();
+            return node;
+        }
+        if (sameShape(existing, node)) {
+            // The copy's children are shared, so only the node itself goes.
+            // Arena slots can only be given back from the top of the arena;
+            // others drop what they own and wait for the arena's reset.
+            MemoryProfiler::noteDiscard(node);
+            NodeArena* arena = NodeArena::active();
+            if (!arena || arena->isLast(node)) {
+                delete node;
+            } else {
+                string().swap(node->nodeType);
+                string().swap(node->value);
+                vector<ASTNode*>().swap(node->children);
+            }
+            return existing;
+        }
+    }
+}
+
+void NodeInterner::grow() {
+    vector<ASTNode*> old(slots.size() * 2, nullptr);
+    old.swap(slots);
+    size_t mask = slots.size() - 1;
+    for (size_t i = 0; i < old.size(); i++) {
+        if (!old[i]) continue;
+        size_t j = old[i]->structuralHash & mask;
+        while (slots[j]) j = (j + 1) & mask;
+        slots[j] = old[i];
+    }
+}
+
+NodeInterner* NodeInterner::active() {
+    return activeInterner;
+}
+
+ASTNode* NodeInterner::share(ASTNode* node) {
+    return activeInterner ? activeInterner->intern(node) : node;
+}
+
+NodeInterner::Scope::Scope(NodeInterner& interner) : previous(activeInterner) {
+    activeInterner = &interner;
+}
+
+NodeInterner::Scope::~Scope() {
+    activeInterner = previous;
+}
+
+bool sameSubtree(const ASTNode* a, const ASTNode* b) {
+    if (a == b) return true;
+    if (a->structuralHash && b->structuralHash) {
+        // Distinct canonical nodes differ unless they came from different interners
+        if (a->structuralHash != b->structuralHash) return false;
+    }
+    if (a->kind != b->kind || a->nodeType != b->nodeType || a->value != b->value || a->children.size() != b->children.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a->children.size(); i++) {
+        if (!sameSubtree(a->children[i], b->children[i])) return false;
+    }
+    return true;
+}
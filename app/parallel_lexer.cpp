@@ -0,0 +1,160 @@
+#include "parallel_lexer.h"
+#include "lexer.h"
+#include "trace.h"
+#include <thread>
+
+using namespace std;
+
+// Character-level states of the sequential lexer. Only the first four can
+// be live at a line start: a '#' comment always ends before its newline and
+// a char literal body is the character after the opening quote.
+enum ScanState {
+    SCAN_NORMAL, SCAN_BLOCK_COMMENT, SCAN_STRING, SCAN_CHAR_CLOSE,
+    SCAN_LINE_COMMENT, SCAN_CHAR_BODY
+};
+
+static int scanStep(int state, char c) {
+    switch (state) {
+        case SCAN_LINE_COMMENT: return c == '\n' ? SCAN_NORMAL : SCAN_LINE_COMMENT;
+        case SCAN_BLOCK_COMMENT: return c == '}' ? SCAN_NORMAL : SCAN_BLOCK_COMMENT;
+        case SCAN_STRING: return c == '"' ? SCAN_NORMAL : SCAN_STRING;
+        case SCAN_CHAR_BODY: return SCAN_CHAR_CLOSE;
+        case SCAN_CHAR_CLOSE:
+            if (c == '\'') return SCAN_NORMAL; // optional closing quote
+            break;
+        default: break;
+    }
+    switch (c) {
+        case '#': return SCAN_LINE_COMMENT;
+        case '{': return SCAN_BLOCK_COMMENT;
+        case '"': return SCAN_STRING;
+        case '\'': return SCAN_CHAR_BODY;
+        default: return SCAN_NORMAL;
+    }
+}
+
+ParallelLexer::ParallelLexer(const string& text, unsigned threadCount)
+    : input(text), threads(threadCount ? threadCount : 1) {}
+
+void ParallelLexer::summarize(ChunkSummary& chunk) const {
+    TraceSpan span("summarize", "lex");
+    int state[ENTRY_STATES];
+    for (int s = 0; s < ENTRY_STATES; s++) {
+        state[s] = s;
+        chunk.syncPos[s] = string::npos;
+    }
+    chunk.syncPos[SCAN_NORMAL] = chunk.begin;
+
+    // Simulate all entry states in one pass; once they agree at a line
+    // boundary they stay in lockstep and a single state is enough
+    bool converged = false;
+    for (size_t i = chunk.begin; i < chunk.end; i++) {
+        char c = input[i];
+        if (converged) {
+            state[0] = scanStep(state[0], c);
+        } else {
+            for (int s = 0; s < ENTRY_STATES; s++) state[s] = scanStep(state[s], c);
+        }
+        if (c != '\n') continue;
+
+        if (i + 1 < chunk.end) {
+            for (int s = 0; s < ENTRY_STATES; s++) {
+                int current = converged ? state[0] : state[s];
+                if (current == SCAN_NORMAL && chunk.syncPos[s] == string::npos) {
+                    chunk.syncPos[s] = i + 1;
+                }
+            }
+        }
+        if (!converged) {
+            converged = true;
+            for (int s = 1; s < ENTRY_STATES; s++) {
+                if (state[s] != state[0]) converged = false;
+            }
+        }
+    }
+
+    for (int s = 0; s < ENTRY_STATES; s++) {
+        chunk.exitState[s] = converged ? state[0] : state[s];
+    }
+}
+
+void ParallelLexer::lexRange(const string& text, size_t baseOffset, bool keepEof, vector<Token>& tokens) {
+    TraceSpan span("lex chunk", "lex");
+    Lexer lexer(text, baseOffset);
+    for (;;) {
+        Token tok = lexer.nextToken();
+        if (tok.type == TOK_EOF) {
+            if (keepEof) tokens.push_back(tok);
+            break;
+        }
+        tokens.push_back(tok);
+    }
+}
+
+vector<Token> ParallelLexer::tokenize() {
+    TraceSpan span("lex", "lex");
+    checkSourceSize(input.size()); // here rather than in a worker's Lexer
+    size_t minChunk = MIN_CHUNK_BYTES;
+    size_t count = min((size_t)threads, input.size() / minChunk);
+    if (count <= 1) {
+        vector<Token> tokens;
+        lexRange(input, 0, true, tokens);
+        return tokens;
+    }
+
+    // Split at newline boundaries near equal byte offsets
+    vector<ChunkSummary> chunks;
+    size_t begin = 0;
+    for (size_t k = 1; k <= count && begin < input.size(); k++) {
+        size_t end = input.size();
+        if (k < count) {
+            size_t nl = input.find('\n', input.size() * k / count);
+            end = nl == string::npos ? input.size() : nl + 1;
+        }
+        if (end <= begin) continue;
+        ChunkSummary chunk;
+        chunk.begin = begin;
+        chunk.end = end;
+        chunks.push_back(chunk);
+        begin = end;
+    }
+
+    vector<thread> workers;
+    for (size_t k = 0; k < chunks.size(); k++) {
+        workers.push_back(thread(&ParallelLexer::summarize, this, std::ref(chunks[k])));
+    }
+    for (size_t k = 0; k < workers.size(); k++) workers[k].join();
+
+    // Resolve each chunk's real entry state and the line start where lexing
+    // can safely resume; chunks that never return to plain code merge into
+    // their predecessor
+    vector<size_t> starts(1, 0);
+    int state = SCAN_NORMAL;
+    for (size_t k = 0; k < chunks.size(); k++) {
+        const ChunkSummary& chunk = chunks[k];
+        if (k > 0 && chunk.syncPos[state] != string::npos) {
+            starts.push_back(chunk.syncPos[state]);
+        }
+        state = chunk.exitState[state];
+    }
+
+    vector<vector<Token> > pieces(starts.size());
+    workers.clear();
+    for (size_t k = 0; k < starts.size(); k++) {
+        size_t end = k + 1 < starts.size() ? starts[k + 1] : input.size();
+        workers.push_back(thread([this, &pieces, &starts, k, end]() {
+            lexRange(input.substr(starts[k], end - starts[k]), starts[k],
+                     k + 1 == starts.size(), pieces[k]);
+        }));
+    }
+    for (size_t k = 0; k < workers.size(); k++) workers[k].join();
+
+    size_t total = 0;
+    for (size_t k = 0; k < pieces.size(); k++) total += pieces[k].size();
+    vector<Token> tokens;
+    tokens.reserve(total);
+    for (size_t k = 0; k < pieces.size(); k++) {
+        tokens.insert(tokens.end(), pieces[k].begin(), pieces[k].end());
+    }
+    return tokens;
+}
@@ -0,0 +1,180 @@
+#include "parallel_printer.h"
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <sys/uio.h>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Nodes per piece: large enough that a piece costs far more to render than
+// to schedule, small enough that a few hundred thousand nodes still split
+static const size_t GRAIN = 8192;
+
+namespace {
+
+// One unit of output. A header is just the line of a node whose subtree
+// is split further; a run is children [first, first + count) of parent,
+// each rendered whole.
+struct Piece {
+    const ASTNode* node;
+    int depth;
+    bool header;
+    size_t first, count;
+    unsigned worker;       // whose buffer holds the text
+    size_t offset, length; // where in it
+};
+
+// Appends whatever an ostream writes to a worker's buffer
+class StringBuffer : public streambuf {
+public:
+    explicit StringBuffer(string& target) : text(target) {}
+
+protected:
+    int overflow(int c) {
+        if (c != EOF) text.push_back((char)c);
+        return c == EOF ? 0 : c;
+    }
+
+    streamsize xsputn(const char* data, streamsize count) {
+        text.append(data, (size_t)count);
+        return count;
+    }
+
+private:
+    string& text;
+};
+
+class Planner {
+public:
+    explicit Planner(vector<Piece>& result) : pieces(result) {}
+
+    // Returns the node count of the subtree as printed. A subtree within
+    // GRAIN adds no pieces, so the caller can fold it into a run; a larger
+    // one adds its header followed by pieces covering its children.
+    size_t plan(const ASTNode* node, int depth) {
+        size_t mark = pieces.size();
+        pieces.push_back(piece(node, depth, true, 0));
+        size_t size = 1;
+        size_t open = SIZE_MAX; // the run still taking children, if any
+        size_t openSize = 0;
+        for (size_t i = 0; i < node->children.size(); i++) {
+            // Reserve the run's place before the child can add its own
+            // pieces, so the output stays in tree order
+            if (open == SIZE_MAX) {
+                open = pieces.size();
+                openSize = 0;
+                pieces.push_back(piece(node, depth + 1, false, i));
+            }
+            size_t before = pieces.size();
+            size_t childSize = plan(node->children[i], depth + 1);
+            size += childSize;
+            if (pieces.size() != before) {
+                open = SIZE_MAX; // a split child ends the run
+                continue;
+            }
+            pieces[open].count++;
+            openSize += childSize;
+            if (openSize >= GRAIN) open = SIZE_MAX;
+        }
+        if (size <= GRAIN) pieces.resize(mark);
+        return size;
+    }
+
+private:
+    vector<Piece>& pieces;
+
+    static Piece piece(const ASTNode* node, int depth, bool header, size_t first) {
+        Piece p = {node, depth, header, first, 0, 0, 0, 0};
+        return p;
+    }
+};
+
+void render(const Piece& piece, string& out) {
+    if (piece.header) {
+        if (piece.depth > 0) out.push_back('\n');
+        for (int i = 0; i < piece.depth; i++) out.append(". ");
+        out.append(piece.node->nodeType);
+        out.append("(" + to_string(piece.node->children.size()) + ")");
+        return;
+    }
+    StringBuffer buffer(out);
+    ostream stream(&buffer);
+    for (size_t i = piece.first; i < piece.first + piece.count; i++) {
+        stream << "\n";
+        piece.node->children[i]->print(piece.depth, false, stream);
+    }
+}
+
+void writeAll(int fd, vector<iovec>& parts) {
+    size_t next = 0;
+    while (next < parts.size()) {
+        size_t batch = parts.size() - next < (size_t)IOV_MAX ? parts.size() - next : (size_t)IOV_MAX;
+        ssize_t written = writev(fd, &parts[next], (int)batch);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            throw runtime_error(string("write failed: ") + strerror(errno));
+        }
+        // Skip what went out, possibly stopping inside a part
+        size_t left = (size_t)written;
+        while (next < parts.size() && left >= parts[next].iov_len) left -= parts[next++].iov_len;
+        if (left) {
+            parts[next].iov_base = (char*)parts[next].iov_base + left;
+            parts[next].iov_len -= left;
+        }
+    }
+}
+
+}
+
+void printTreeParallel(const ASTNode* root, int fd, unsigned threads) {
+    vector<Piece> pieces;
+    Planner(pieces).plan(root, 0);
+    if (pieces.empty()) {
+        // Too small to split
+        string text;
+        StringBuffer buffer(text);
+        ostream stream(&buffer);
+        root->print(0, true, stream);
+        vector<iovec> parts(1);
+        parts[0].iov_base = &text[0];
+        parts[0].iov_len = text.size();
+        writeAll(fd, parts);
+        return;
+    }
+
+    if (threads < 1) threads = 1;
+    if (threads > pieces.size()) threads = (unsigned)pieces.size();
+    vector<string> buffers(threads);
+    atomic<size_t> next(0);
+    auto worker = [&](unsigned id) {
+        for (size_t i = next.fetch_add(1); i < pieces.size(); i = next.fetch_add(1)) {
+            pieces[i].worker = id;
+            pieces[i].offset = buffers[id].size();
+            render(pieces[i], buffers[id]);
+            pieces[i].length = buffers[id].size() - pieces[i].offset;
+        }
+    };
+    vector<thread> pool;
+    for (unsigned t = 1; t < threads; t++) pool.push_back(thread(worker, t));
+    worker(0);
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+
+    // Buffers no longer grow, so their addresses are stable now
+    vector<iovec> parts;
+    parts.reserve(pieces.size());
+    for (size_t i = 0; i < pieces.size(); i++) {
+        if (!pieces[i].length) continue;
+        iovec part;
+        part.iov_base = &buffers[pieces[i].worker][pieces[i].offset];
+        part.iov_len = pieces[i].length;
+        parts.push_back(part);
+    }
+    writeAll(fd, parts);
+}
@@ -0,0 +1,328 @@
+#include "parse_daemon.h"
+#include "parser.h"
+#include "source_files.h"
+#include "node_arena.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const size_t LATENCY_SAMPLES = 65536;
+static const size_t MAX_REQUEST_BYTES = 1u << 30;
+
+static volatile sig_atomic_t stopRequested = 0;
+static int listenFd = -1;
+
+static void onStopSignal(int) {
+    stopRequested = 1;
+    // Wakes the accept() loop; shutdown is async-signal-safe
+    if (listenFd >= 0) shutdown(listenFd, SHUT_RDWR);
+}
+
+// Buffered reads of header lines and payloads from a socket
+class SocketReader {
+public:
+    explicit SocketReader(int socket) : fd(socket), pos(0), len(0) {}
+
+    bool readLine(string& line) {
+        line.clear();
+        for (;;) {
+            if (pos == len && !fill()) return false;
+            char* nl = static_cast<char*>(memchr(buffer + pos, '\n', len - pos));
+            if (nl) {
+                line.append(buffer + pos, nl - (buffer + pos));
+                pos = nl - buffer + 1;
+                return true;
+            }
+            line.append(buffer + pos, len - pos);
+            pos = len;
+        }
+    }
+
+    bool readBytes(size_t count, string& out) {
+        out.clear();
+        out.reserve(count);
+        while (out.size() < count) {
+            if (pos == len && !fill()) return false;
+            size_t take = min(count - out.size(), len - pos);
+            out.append(buffer + pos, take);
+            pos += take;
+        }
+        return true;
+    }
+
+private:
+    int fd;
+    char buffer[64 * 1024];
+    size_t pos;
+    size_t len;
+
+    bool fill() {
+        ssize_t n;
+        do n = read(fd, buffer, sizeof(buffer)); while (n < 0 && errno == EINTR);
+        if (n <= 0) return false;
+        pos = 0;
+        len = (size_t)n;
+        return true;
+    }
+};
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+static bool sendResponse(int fd, bool ok, const string& payload) {
+    char header[64];
+    int n = snprintf(header, sizeof(header), "%s %zu\n", ok ? "OK" : "ERR", payload.size());
+    return writeAll(fd, header, n) && writeAll(fd, payload.data(), payload.size());
+}
+
+static bool connectTo(const string& path, int& fd) {
+    sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path)) return false;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        close(fd);
+        return false;
+    }
+    return true;
+}
+
+ParseDaemon::ParseDaemon(const string& socketPath, unsigned workerCount, const ParseLimits& parseLimits)
+    : path(socketPath), workers(workerCount ? workerCount : 1), limits(parseLimits), stopping(false),
+      latencyNext(0), requests(0) {}
+
+int ParseDaemon::run() {
+    sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        cerr << "Error: socket path too long: " << path << endl;
+        return 1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str()); // stale socket from an earlier run
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listenFd, 128) < 0) {
+        cerr << "Error: cannot listen on " << path << ": " << strerror(errno) << endl;
+        return 1;
+    }
+
+    signal(SIGINT, onStopSignal);
+    signal(SIGTERM, onStopSignal);
+    signal(SIGPIPE, SIG_IGN);
+    cerr << "winzigc daemon listening on " << path << " with " << workers << " workers" << endl;
+
+    vector<thread> pool;
+    for (unsigned i = 0; i < workers; i++) pool.push_back(thread(&ParseDaemon::workerLoop, this));
+
+    while (!stopRequested) {
+        int client = accept(listenFd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        lock_guard<mutex> lock(queueMutex);
+        pending.push_back(client);
+        queueReady.notify_one();
+    }
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+        // Unblock workers waiting on idle clients
+        for (set<int>::iterator it = active.begin(); it != active.end(); ++it) {
+            shutdown(*it, SHUT_RD);
+        }
+    }
+    queueReady.notify_all();
+    for (size_t i = 0; i < pool.size(); i++) pool[i].join();
+
+    close(listenFd);
+    listenFd = -1;
+    unlink(path.c_str());
+    cerr << statsReport();
+    return 0;
+}
+
+void ParseDaemon::workerLoop() {
+    NodeArena arena;
+    arena.setLimits(limits);
+    ostringstream output;
+    for (;;) {
+        int fd;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueReady.wait(lock, [this]() { return stopping || !pending.empty(); });
+            if (stopping) {
+                // Drop connections that were never served
+                while (!pending.empty()) {
+                    close(pending.front());
+                    pending.pop_front();
+                }
+                return;
+            }
+            fd = pending.front();
+            pending.pop_front();
+            active.insert(fd);
+        }
+        serveConnection(fd, arena, output);
+        {
+            lock_guard<mutex> lock(queueMutex);
+            active.erase(fd);
+        }
+        close(fd);
+    }
+}
+
+void ParseDaemon::serveConnection(int fd, NodeArena& arena, ostringstream& output) {
+    SocketReader reader(fd);
+    string header;
+    string source;
+
+    while (reader.readLine(header)) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        if (header == "STATS") {
+            if (!sendResponse(fd, true, statsReport())) return;
+            continue;
+        }
+
+        bool ok = true;
+        string error;
+        if (header.compare(0, 6, "PARSE ") == 0) {
+            try {
+                if (!readSourceFile(header.substr(6), source)) {
+                    ok = false;
+                    error = "Cannot open file " + header.substr(6);
+                }
+            } catch (const exception& e) {
+                ok = false;
+                error = e.what();
+            }
+        } else if (header.compare(0, 7, "SOURCE ") == 0) {
+            size_t size = strtoul(header.c_str() + 7, nullptr, 10);
+            if (size > MAX_REQUEST_BYTES) {
+                sendResponse(fd, false, "request too large");
+                return;
+            }
+            if (!reader.readBytes(size, source)) return;
+        } else {
+            sendResponse(fd, false, "unknown request: " + header);
+            return;
+        }
+
+        if (ok) {
+            output.str("");
+            try {
+                NodeArena::Scope scope(arena);
+                Parser parser(source);
+                parser.setLimits(limits);
+                ASTNode* ast = parser.parseProgram();
+                if (ast) {
+                    ast->print(0, true, output);
+                    output << "\n";
+                } else {
+                    ok = false;
+                    error = "Parse error";
+                }
+            } catch (const exception& e) {
+                ok = false;
+                error = e.what();
+            }
+            arena.reset();
+        }
+
+        bool sent = sendResponse(fd, ok, ok ? output.str() : error);
+        chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+        recordLatency(elapsed.count());
+        if (!sent) return;
+    }
+}
+
+void ParseDaemon::recordLatency(double ms) {
+    lock_guard<mutex> lock(statsMutex);
+    requests++;
+    if (latencies.size() < LATENCY_SAMPLES) {
+        latencies.push_back(ms);
+    } else {
+        latencies[latencyNext] = ms;
+        latencyNext = (latencyNext + 1) % LATENCY_SAMPLES;
+    }
+}
+
+string ParseDaemon::statsReport() {
+    vector<double> sorted;
+    unsigned long long total;
+    {
+        lock_guard<mutex> lock(statsMutex);
+        sorted = latencies;
+        total = requests;
+    }
+    sort(sorted.begin(), sorted.end());
+
+    ostringstream os;
+    os << "requests: " << total << "\n";
+    if (!sorted.empty()) {
+        size_t p50 = (size_t)ceil(0.50 * sorted.size()) - 1;
+        size_t p99 = (size_t)ceil(0.99 * sorted.size()) - 1;
+        os << "p50 latency: " << sorted[p50] << " ms\n";
+        os << "p99 latency: " << sorted[p99] << " ms\n";
+    }
+    return os.str();
+}
+
+int runParseClient(const string& socketPath, const string& request, const string& payload) {
+    int fd;
+    if (!connectTo(socketPath, fd)) {
+        cerr << "Error: cannot connect to " << socketPath << endl;
+        return 1;
+    }
+
+    string message = request + "\n" + payload;
+    SocketReader reader(fd);
+    string header;
+    string body;
+    bool ok = writeAll(fd, message.data(), message.size()) && reader.readLine(header);
+    size_t space = header.find(' ');
+    if (ok && space != string::npos) {
+        ok = reader.readBytes(strtoul(header.c_str() + space + 1, nullptr, 10), body);
+    }
+    close(fd);
+
+    if (!ok) {
+        cerr << "Error: no response from daemon" << endl;
+        return 1;
+    }
+    if (header.compare(0, 3, "OK ") != 0) {
+        cerr << "Error: " << body << endl;
+        return 1;
+    }
+    cout << body;
+    return 0;
+}
@@ -1,13 +1,65 @@
 #include "parser.h"
+#include "token_ring.h"
+#include "node_interner.h"
+#include "trace.h"
+#include "lazy_bodies.h"
+#include "nary_chains.h"
 #include <iostream>
 
-Parser::Parser(const std::string& input) : lexer(input) {
+Parser::Parser(const std::string& input, size_t baseOffset)
+    : lexer(input, baseOffset), tokenIndex(0), buffered(false), ring(nullptr), depth(0), lazyBodies(nullptr), flatChains(false), finished(false) {
     advance(); // Get first token
 }
 
+Parser::Parser(std::istream& in)
+    : lexer(in), tokenIndex(0), buffered(false), ring(nullptr), depth(0), lazyBodies(nullptr), flatChains(false), finished(false) {
+    advance(); // Get first token
+}
+
+Parser::Parser(const std::vector<Token>& lexed)
+    : lexer(""), tokens(lexed), tokenIndex(0), buffered(true), ring(nullptr), depth(0), lazyBodies(nullptr), flatChains(false), finished(false) {
+    advance(); // Get first token
+}
+
+Parser::Parser(TokenRing& source)
+    : lexer(""), tokenIndex(0), buffered(true), ring(&source), depth(0), lazyBodies(nullptr), flatChains(false), finished(false) {
+    advance(); // Get first token
+}
+
+// Holds one level of nesting for the lifetime of a recursive parse function
+struct Parser::Nesting {
+    Parser& parser;
+    explicit Nesting(Parser& p) : parser(p) {
+        parser.checkDepth(1);
+        parser.depth++;
+    }
+    ~Nesting() { parser.depth--; }
+};
+
+void Parser::checkDepth(size_t extra) {
+    // Fail before the stack or the tree gets deeper than the budget allows
+    if (limits.maxDepth && depth + extra > limits.maxDepth) {
+        throw ResourceLimitError("nesting depth limit of " + std::to_string(limits.maxDepth) +
+                                 " exceeded at byte " + std::to_string(currentToken.offset));
+    }
+}
+
+Token Parser::nextToken() {
+    if (!buffered) return lexer.nextToken();
+    
+    if (tokenIndex >= tokens.size() && ring) {
+        ring->pop(tokens);
+        tokenIndex = 0;
+        // The producer's last batch ends with EOF
+        if (!tokens.empty() && tokens.back().type == TOK_EOF) ring = nullptr;
+    }
+    if (tokenIndex < tokens.size()) return tokens[tokenIndex++];
+    return Token(TOK_EOF);
+}
+
 void Parser::advance() {
     do {
-        currentToken = lexer.nextToken();
+        currentToken = nextToken();
     } while (currentToken.type == TOK_NEWLINE); // Skip newlines
 }
 
@@ -25,26 +77,27 @@ bool Parser::consume(TokenType type) {
 
 ASTNode* Parser::createIdentifierNode(const std::string& name) {
     ASTNode* node = new ASTNode("<identifier>");
-    node->addChild(new ASTNode(name));
-    return node;
+    node->addChild(new ASTNode(name, NK_TEXT));
+    // Literals are shared as soon as they exist, while still on top of the arena
+    return NodeInterner::share(node);
 }
 
 ASTNode* Parser::createIntegerNode(const std::string& value) {
     ASTNode* node = new ASTNode("<integer>");
-    node->addChild(new ASTNode(value));
-    return node;
+    node->addChild(new ASTNode(value, NK_TEXT));
+    return NodeInterner::share(node);
 }
 
 ASTNode* Parser::createCharNode(const std::string& value) {
     ASTNode* node = new ASTNode("<char>");
-    node->addChild(new ASTNode(value));
-    return node;
+    node->addChild(new ASTNode(value, NK_TEXT));
+    return NodeInterner::share(node);
 }
 
 ASTNode* Parser::createStringNode(const std::string& value) {
     ASTNode* node = new ASTNode("<string>");
-    node->addChild(new ASTNode(value));
-    return node;
+    node->addChild(new ASTNode(value, NK_TEXT));
+    return NodeInterner::share(node);
 }
 
 ASTNode* Parser::parseProgram() {
@@ -64,7 +117,7 @@ ASTNode* Parser::parseProgram() {
     program->addChild(parseBody());
     program->addChild(parseName());
     
-    consume(TOK_DOT);
+    finished = consume(TOK_DOT) && match(TOK_EOF);
     
     return program;
 }
@@ -214,6 +267,7 @@ ASTNode* Parser::parseDcln() {
 
 ASTNode* Parser::parseExpression() {
     ASTNode* left = parseTerm();
+    size_t chain = 0; // a left-deep operator chain nests without recursing
     
     while (match(TOK_LESS_EQUAL) || match(TOK_LESS) || match(TOK_GREATER_EQUAL) || 
            match(TOK_GREATER) || match(TOK_EQUAL) || match(TOK_NOT_EQUAL)) {
@@ -232,6 +286,7 @@ ASTNode* Parser::parseExpression() {
         advance();
         ASTNode* right = parseTerm();
         
+        checkDepth(++chain);
         ASTNode* opNode = new ASTNode(op);
         opNode->addChild(left);
         opNode->addChild(right);
@@ -243,6 +298,7 @@ ASTNode* Parser::parseExpression() {
 
 ASTNode* Parser::parseTerm() {
     ASTNode* left = parseFactor();
+    size_t chain = 0; // a left-deep operator chain nests without recursing
     
     while (match(TOK_PLUS) || match(TOK_MINUS) || match(TOK_OR)) {
         std::string op;
@@ -256,6 +312,13 @@ ASTNode* Parser::parseTerm() {
         advance();
         ASTNode* right = parseFactor();
         
+        if (flatChains && left && left->nodeType == op && isAssociative(left->kind)) {
+            // One more operand, also for a parenthesized chain on the left,
+            // as flattenChains would fold it
+            left->addChild(right);
+            continue;
+        }
+        checkDepth(++chain);
         ASTNode* opNode = new ASTNode(op);
         opNode->addChild(left);
         opNode->addChild(right);
@@ -267,6 +330,7 @@ ASTNode* Parser::parseTerm() {
 
 ASTNode* Parser::parseFactor() {
     ASTNode* left = parsePrimary();
+    size_t chain = 0; // a left-deep operator chain nests without recursing
     
     while (match(TOK_MULTIPLY) || match(TOK_DIVIDE) || match(TOK_AND) || match(TOK_MOD)) {
         std::string op;
@@ -281,6 +345,13 @@ ASTNode* Parser::parseFactor() {
         advance();
         ASTNode* right = parsePrimary();
         
+        if (flatChains && left && left->nodeType == op && isAssociative(left->kind)) {
+            // One more operand, also for a parenthesized chain on the left,
+            // as flattenChains would fold it
+            left->addChild(right);
+            continue;
+        }
+        checkDepth(++chain);
         ASTNode* opNode = new ASTNode(op);
         opNode->addChild(left);
         opNode->addChild(right);
@@ -291,6 +362,8 @@ ASTNode* Parser::parseFactor() {
 }
 
 ASTNode* Parser::parsePrimary() {
+    Nesting nesting(*this);
+    
     // Handle unary operators
     if (match(TOK_MINUS)) {
         advance();
@@ -425,10 +498,12 @@ ASTNode* Parser::parseSubProgs() {
 }
 
 ASTNode* Parser::parseFcn() {
+    TraceSpan span("parseFcn", "parse");
     ASTNode* fcn = new ASTNode("fcn");
     
     consume(TOK_FUNCTION); // 'function'
     fcn->addChild(parseName()); // function name
+    if (span.active()) span.setDetail(fcn->children[0]->children[0]->nodeType);
     
     consume(TOK_LPAREN);
     fcn->addChild(parseParams()); // parameters
@@ -442,7 +517,8 @@ ASTNode* Parser::parseFcn() {
     fcn->addChild(parseConsts()); // local constants
     fcn->addChild(parseTypes());  // local types
     fcn->addChild(parseDclns());  // local declarations
-    fcn->addChild(parseBody());   // function body
+    // function body, or a placeholder for it
+    fcn->addChild(lazyBodies && match(TOK_BEGIN) ? skipBody() : parseBody());
     fcn->addChild(parseName());   // function name again
     
     consume(TOK_SEMICOLON);
@@ -462,6 +538,22 @@ ASTNode* Parser::parseParams() {
     return params;
 }
 
+// Steps over a function body by matching begin and case with end, lexing
+// but building nothing
+ASTNode* Parser::skipBody() {
+    size_t begin = currentToken.offset;
+    size_t open = 0;
+    do {
+        if (match(TOK_BEGIN) || match(TOK_CASE)) {
+            open++;
+        } else if (match(TOK_END)) {
+            open--;
+        }
+        advance();
+    } while (open && !match(TOK_EOF));
+    return lazyBodies->defer(begin, match(TOK_EOF) ? std::string::npos : currentToken.offset);
+}
+
 ASTNode* Parser::parseBody() {
     ASTNode* block = new ASTNode("block");
     
@@ -501,6 +593,8 @@ ASTNode* Parser::parseBody() {
 }
 
 ASTNode* Parser::parseStatement() {
+    Nesting nesting(*this);
+    
     // Assignment or swap
     if (match(TOK_IDENTIFIER)) {
         std::string name = currentToken.value;
@@ -631,7 +725,7 @@ ASTNode* Parser::parseStatement() {
         consume(TOK_OF);
         
         // Parse case clauses
-        while (!match(TOK_END) && !match(TOK_OTHERWISE)) {
+        while (!match(TOK_END) && !match(TOK_OTHERWISE) && !match(TOK_EOF)) {
             ASTNode* clause = parseCaseclause();
             if (clause) {
                 caseNode->addChild(clause);
@@ -0,0 +1,83 @@
+#include "perf_counters.h"
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const uint64_t counterConfig[PerfCounters::COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+};
+
+static int openCounter(uint64_t config, int group) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = group < 0; // the leader starts the whole group
+    attr.exclude_kernel = 1;   // allowed at perf_event_paranoid 2
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+PerfCounters::PerfCounters() : opened(0), leader(-1) {
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        fds[c] = openCounter(counterConfig[c], leader);
+        order[c] = -1;
+        if (fds[c] < 0) {
+            if (reason.empty()) reason = string("perf_event_open: ") + strerror(errno);
+            continue;
+        }
+        if (leader < 0) leader = fds[c];
+        order[c] = opened++;
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        if (fds[c] >= 0) close(fds[c]);
+    }
+}
+
+void PerfCounters::start() {
+    if (leader >= 0) {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    started = chrono::steady_clock::now();
+}
+
+PerfCounters::Sample PerfCounters::stop() {
+    chrono::steady_clock::time_point stopped = chrono::steady_clock::now();
+    Sample sample;
+    sample.wallNs = chrono::duration<double, nano>(stopped - started).count();
+    for (int c = 0; c < COUNTER_COUNT; c++) sample.values[c] = 0;
+    if (leader < 0) return sample;
+
+    ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    // nr, time_enabled, time_running, then one value per counter
+    uint64_t data[3 + COUNTER_COUNT];
+    if (read(leader, data, sizeof(data)) < (ssize_t)(3 * sizeof(uint64_t))) return sample;
+    // Scale up if the kernel multiplexed the group off the PMU for a while
+    double scale = data[2] ? (double)data[1] / (double)data[2] : 1.0;
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+        if (order[c] >= 0) sample.values[c] = (uint64_t)(data[3 + order[c]] * scale);
+    }
+    return sample;
+}
+
+const char* PerfCounters::name(Counter counter) {
+    switch (counter) {
+        case CYCLES: return "cycles";
+        case INSTRUCTIONS: return "instructions";
+        case CACHE_MISSES: return "cache-misses";
+        case BRANCH_MISSES: return "branch-misses";
+        default: return "?";
+    }
+}
@@ -0,0 +1,50 @@
+#include "source_files.h"
+#include "lexer.h"
+#include <algorithm>
+#include <fstream>
+#include <dirent.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+bool readSourceFile(const string& filename, string& input) {
+    ifstream file(filename.c_str());
+    if (!file.is_open()) return false;
+    
+    input.clear();
+    string line;
+    while (getline(file, line)) {
+        input += line + "\n";
+        checkSourceSize(input.size());
+    }
+    return true;
+}
+
+static void discoverInto(const string& dir, vector<string>& found) {
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) return;
+    vector<string> names;
+    while (dirent* entry = readdir(handle)) {
+        if (entry->d_name[0] != '.') names.push_back(entry->d_name);
+    }
+    closedir(handle);
+    for (size_t i = 0; i < names.size(); i++) {
+        const string& name = names[i];
+        string path = dir + "/" + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) continue;
+        if (S_ISDIR(info.st_mode)) {
+            discoverInto(path, found);
+        } else if (S_ISREG(info.st_mode) &&
+                   !(name.size() > 5 && name.compare(name.size() - 5, 5, ".tree") == 0)) {
+            found.push_back(path);
+        }
+    }
+}
+
+vector<string> findSourceFiles(const string& dir) {
+    vector<string> found;
+    discoverInto(dir, found);
+    sort(found.begin(), found.end());
+    return found;
+}
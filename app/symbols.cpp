@@ -0,0 +1,188 @@
+#include "symbols.h"
+#include "trace.h"
+#include <stdexcept>
+
+using namespace std;
+
+string leafText(const ASTNode* node) {
+    if (!node || node->children.empty()) return "";
+    return node->children[0]->nodeType;
+}
+
+int integerValue(const string& text) {
+    unsigned int value = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        value = value * 10u + (unsigned int)(text[i] - '0');
+    }
+    return (int)value;
+}
+
+int charValue(const string& text) {
+    return text.size() > 1 ? (unsigned char)text[1] : 0;
+}
+
+const Symbol* Scope::find(const string& name) const {
+    map<string, Symbol>::const_iterator it = symbols.find(name);
+    return it == symbols.end() ? nullptr : &it->second;
+}
+
+ProgramInfo::ProgramInfo(const ASTNode* program) {
+    TraceSpan span("symbols", "semantic");
+    if (!program || program->nodeType != "program" || program->children.size() < 7) {
+        throw runtime_error("malformed program tree");
+    }
+    name = leafText(program->children[0]);
+
+    declareConsts(program->children[1], globals);
+    declareTypes(program->children[2], globals);
+    declareVars(program->children[3], globals, nullptr);
+
+    const ASTNode* subprogs = program->children[4];
+    for (size_t i = 0; i < subprogs->children.size(); i++) {
+        const ASTNode* fcn = subprogs->children[i];
+        FunctionInfo info;
+        info.name = leafText(fcn->children[0]);
+        info.node = fcn;
+        functionIndex[info.name] = functions.size();
+        globals.symbols[info.name] = Symbol(SYM_FUNCTION, leafText(fcn->children[2]));
+        functions.push_back(info);
+    }
+
+    for (size_t i = 0; i < functions.size(); i++) {
+        FunctionInfo& info = functions[i];
+        const ASTNode* fcn = info.node;
+        declareVars(fcn->children[1], info.locals, &info.params);
+        declareConsts(fcn->children[3], info.locals);
+        declareTypes(fcn->children[4], info.locals);
+        declareVars(fcn->children[5], info.locals, nullptr);
+    }
+
+    for (size_t i = 0; i < functions.size(); i++) {
+        collectImplicit(functions[i].node->children[6], &functions[i]);
+    }
+    collectImplicit(program->children[5], nullptr);
+}
+
+const FunctionInfo* ProgramInfo::findFunction(const string& fname) const {
+    map<string, size_t>::const_iterator it = functionIndex.find(fname);
+    return it == functionIndex.end() ? nullptr : &functions[it->second];
+}
+
+const Symbol* ProgramInfo::lookup(const FunctionInfo* fn, const string& sym) const {
+    if (fn) {
+        const Symbol* local = fn->locals.find(sym);
+        if (local) return local;
+    }
+    const Symbol* global = globals.find(sym);
+    if (global) return global;
+
+    // Predeclared boolean constants
+    static const Symbol trueSym(SYM_CONST, "boolean", 1);
+    static const Symbol falseSym(SYM_CONST, "boolean", 0);
+    if (sym == "true") return &trueSym;
+    if (sym == "false") return &falseSym;
+    return nullptr;
+}
+
+void ProgramInfo::declareConsts(const ASTNode* consts, Scope& scope) {
+    for (size_t i = 0; i < consts->children.size(); i++) {
+        const ASTNode* c = consts->children[i];
+        if (c->children.size() < 2) continue;
+
+        const ASTNode* valueNode = c->children[1];
+        string text = leafText(valueNode);
+        int value = 0;
+        string type = "integer";
+        if (valueNode->nodeType == "<integer>") {
+            value = integerValue(text);
+        } else if (valueNode->nodeType == "<char>") {
+            value = charValue(text);
+            type = "char";
+        } else {
+            const Symbol* ref = scope.find(text);
+            if (!ref) ref = lookup(nullptr, text);
+            if (!ref || (ref->kind != SYM_CONST && ref->kind != SYM_LITERAL)) {
+                throw runtime_error("constant '" + text + "' is not defined");
+            }
+            value = ref->value;
+            type = ref->typeName;
+        }
+
+        string cname = leafText(c->children[0]);
+        scope.symbols[cname] = Symbol(SYM_CONST, type, value);
+        scope.constants.push_back(cname);
+    }
+}
+
+void ProgramInfo::declareTypes(const ASTNode* types, Scope& scope) {
+    for (size_t i = 0; i < types->children.size(); i++) {
+        const ASTNode* t = types->children[i];
+        if (t->children.size() < 2) continue;
+
+        string tname = leafText(t->children[0]);
+        const ASTNode* lit = t->children[1];
+        for (size_t j = 0; j < lit->children.size(); j++) {
+            string lname = leafText(lit->children[j]);
+            scope.symbols[lname] = Symbol(SYM_LITERAL, tname, (int)j);
+            scope.constants.push_back(lname);
+        }
+    }
+}
+
+void ProgramInfo::declareVars(const ASTNode* dclns, Scope& scope, vector<string>* names) {
+    for (size_t i = 0; i < dclns->children.size(); i++) {
+        const ASTNode* var = dclns->children[i];
+        if (var->children.empty()) continue;
+
+        string type = leafText(var->children.back());
+        for (size_t j = 0; j + 1 < var->children.size(); j++) {
+            string vname = leafText(var->children[j]);
+            if (scope.symbols.count(vname)) continue;
+            scope.symbols[vname] = Symbol(SYM_VAR, type, 0, (int)scope.vars.size());
+            scope.vars.push_back(vname);
+            if (names) names->push_back(vname);
+        }
+    }
+}
+
+void ProgramInfo::collectImplicit(const ASTNode* node, const FunctionInfo* fn) {
+    if (!node) return;
+
+    if (node->nodeType == "<identifier>") {
+        string sym = leafText(node);
+        if (!lookup(fn, sym)) {
+            globals.symbols[sym] = Symbol(SYM_VAR, "integer", 0, (int)globals.vars.size());
+            globals.vars.push_back(sym);
+            implicitGlobals.push_back(sym);
+        }
+        return;
+    }
+
+    // The callee of a call is a function name, not a variable reference
+    size_t first = node->nodeType == "call" ? 1 : 0;
+    for (size_t i = first; i < node->children.size(); i++) {
+        collectImplicit(node->children[i], fn);
+    }
+}
+
+void printSignatures(const ASTNode* program, ostream& out) {
+    for (size_t i = 0; i < program->children.size(); i++) {
+        const ASTNode* subprogs = program->children[i];
+        if (subprogs->kind != NK_SUBPROGS) continue;
+        for (size_t f = 0; f < subprogs->children.size(); f++) {
+            const ASTNode* fcn = subprogs->children[f];
+            out << leafText(fcn->children[0]) << "(";
+            const ASTNode* params = fcn->children[1];
+            for (size_t p = 0; p < params->children.size(); p++) {
+                // var(n): the names, then their type
+                const ASTNode* dcln = params->children[p];
+                if (p) out << "; ";
+                for (size_t v = 0; v + 1 < dcln->children.size(); v++) {
+                    out << (v ? ", " : "") << leafText(dcln->children[v]);
+                }
+                out << ": " << leafText(dcln->children.back());
+            }
+            out << "): " << leafText(fcn->children[2]) << "\n";
+        }
+    }
+}
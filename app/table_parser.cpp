@@ -0,0 +1,172 @@
+#include "table_parser.h"
+#include "winzig_grammar.h"
+#include "node_interner.h"
+#include <stdexcept>
+#include <utility>
+
+using namespace grammar;
+
+namespace {
+
+const int MARKED = -1; // children from the latest mark to the top
+
+// What each BUILD_* action makes, in the order of the Action enum
+struct Build {
+    const char* type;
+    int arity;
+    bool chained; // a binary operator counted against the depth limit
+};
+
+const Build BUILDS[] = {
+    {"program", 7, false}, {"consts", MARKED, false}, {"const", 2, false}, {"types", MARKED, false},
+    {"type", 2, false}, {"lit", MARKED, false}, {"dclns", MARKED, false}, {"var", MARKED, false},
+    {"subprogs", MARKED, false}, {"fcn", 8, false}, {"params", MARKED, false}, {"block", MARKED, false},
+    {"assign", 2, false}, {"swap", 2, false}, {"output", MARKED, false},
+    {"string", 1, false}, {"integer", 1, false}, {"if", MARKED, false}, {"while", 2, false},
+    {"repeat", MARKED, false}, {"for", 4, false}, {"loop", MARKED, false},
+    {"case", MARKED, false}, {"case_clause", 2, false}, {"..", 2, false}, {"otherwise", 1, false},
+    {"read", MARKED, false}, {"exit", 0, false}, {"return", 1, false},
+    {"<null>", 0, false}, {"true", 0, false},
+    {"<=", 2, true}, {"<", 2, true}, {">=", 2, true}, {">", 2, true}, {"=", 2, true}, {"<>", 2, true},
+    {"+", 2, true}, {"-", 2, true}, {"or", 2, true},
+    {"*", 2, true}, {"/", 2, true}, {"and", 2, true}, {"mod", 2, true},
+    {"-", 1, false}, {"not", 1, false}, {"succ", 1, false}, {"pred", 1, false}, {"chr", 1, false},
+    {"ord", 1, false}, {"eof", 0, false}, {"call", MARKED, false},
+};
+static_assert(sizeof(BUILDS) / sizeof(BUILDS[0]) == ACTION_COUNT - BUILD_PROGRAM, "one entry per BUILD_* action");
+
+// Node kinds are classified once rather than per node
+struct BuildKinds {
+    NodeKind kind[ACTION_COUNT - BUILD_PROGRAM];
+    BuildKinds() {
+        for (unsigned b = 0; b < ACTION_COUNT - BUILD_PROGRAM; b++) kind[b] = classifyNodeType(BUILDS[b].type);
+    }
+};
+
+const BuildKinds& buildKinds() {
+    static const BuildKinds kinds;
+    return kinds;
+}
+
+// Statements and primaries are where the hand-written parser recurses;
+// expression levels are where it loops over operators
+bool opensNesting(unsigned n) { return n == NT_STMT || n == NT_PRIMARY; }
+bool opensChain(unsigned n) { return n == NT_EXPR || n == NT_TERM || n == NT_FACTOR; }
+
+ASTNode* literal(const char* type, const std::string& text) {
+    ASTNode* node = new ASTNode(type);
+    node->addChild(new ASTNode(text, NK_TEXT));
+    return NodeInterner::share(node);
+}
+
+std::string describe(const Token& token) {
+    if (token.type == TOK_EOF) return "end of input";
+    return "'" + token.value + "'";
+}
+
+}
+
+TableParser::TableParser(const std::string& input)
+    : lexer(input), tokenIndex(0), buffered(false), depth(0) {
+    advance();
+}
+
+TableParser::TableParser(std::istream& in)
+    : lexer(in), tokenIndex(0), buffered(false), depth(0) {
+    advance();
+}
+
+TableParser::TableParser(const std::vector<Token>& lexed)
+    : lexer(""), tokens(lexed), tokenIndex(0), buffered(true), depth(0) {
+    advance();
+}
+
+void TableParser::advance() {
+    do {
+        if (!buffered) {
+            currentToken = lexer.nextToken();
+        } else {
+            currentToken = tokenIndex < tokens.size() ? tokens[tokenIndex++] : Token(TOK_EOF);
+        }
+    } while (currentToken.type == TOK_NEWLINE);
+}
+
+void TableParser::checkDepth(size_t extra) {
+    // Same budget and message as Parser::checkDepth
+    if (limits.maxDepth && depth + extra > limits.maxDepth) {
+        throw ResourceLimitError("nesting depth limit of " + std::to_string(limits.maxDepth) +
+                                 " exceeded at byte " + std::to_string(currentToken.offset));
+    }
+}
+
+void TableParser::syntaxError() {
+    throw std::runtime_error("syntax error at byte " + std::to_string(currentToken.offset) + ": unexpected " +
+                             describe(currentToken));
+}
+
+// Replaces nonterminal n on the symbol stack by the right-hand side the
+// table predicts for the current token, last symbol pushed first
+void TableParser::expand(unsigned n) {
+    uint8_t p = PREDICT.cell[n * TOKEN_COUNT + currentToken.type];
+    if (p == NO_PRODUCTION) syntaxError();
+    if (opensNesting(n)) {
+        checkDepth(1);
+        depth++;
+        symbols.push_back(sym(ACT_END_NESTING));
+    }
+    if (opensChain(n)) {
+        chains.push_back(0);
+        symbols.push_back(sym(ACT_END_CHAIN));
+    }
+    const Symbol* rhs = PRODUCTIONS[p].rhs;
+    for (unsigned i = RHS_LENGTH.length[p]; i > 0; i--) symbols.push_back(rhs[i - 1]);
+}
+
+void TableParser::act(unsigned action) {
+    switch (action) {
+        case ACT_IDENT: nodes.push_back(literal("<identifier>", lastToken.value)); return;
+        case ACT_INTEGER: nodes.push_back(literal("<integer>", lastToken.value)); return;
+        case ACT_CHAR: nodes.push_back(literal("<char>", lastToken.value)); return;
+        case ACT_STRING: nodes.push_back(literal("<string>", lastToken.value)); return;
+        case ACT_MARK: marks.push_back(nodes.size()); return;
+        case ACT_MARK_LAST: marks.push_back(nodes.size() - 1); return;
+        case ACT_END_NESTING: depth--; return;
+        case ACT_END_CHAIN: chains.pop_back(); return;
+        default: break;
+    }
+
+    const Build& build = BUILDS[action - BUILD_PROGRAM];
+    if (build.chained) checkDepth(++chains.back());
+    size_t from = nodes.size() - build.arity;
+    if (build.arity == MARKED) {
+        from = marks.back();
+        marks.pop_back();
+    }
+    ASTNode* node = new ASTNode(build.type, buildKinds().kind[action - BUILD_PROGRAM]);
+    node->children.reserve(nodes.size() - from);
+    for (size_t i = from; i < nodes.size(); i++) node->addChild(nodes[i]);
+    nodes.resize(from);
+    nodes.push_back(node);
+}
+
+ASTNode* TableParser::parseProgram() {
+    symbols.assign(1, sym(NT_PROGRAM));
+    nodes.clear();
+    marks.clear();
+    chains.clear();
+
+    while (!symbols.empty()) {
+        Symbol top = symbols.back();
+        symbols.pop_back();
+        if (isToken(top)) {
+            if (currentToken.type != tokenOf(top)) syntaxError();
+            lastToken = std::move(currentToken);
+            advance();
+        } else if (isNonTerminal(top)) {
+            expand(nonTerminalOf(top));
+        } else {
+            act(actionOf(top));
+        }
+    }
+    return nodes.back();
+}
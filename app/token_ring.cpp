@@ -0,0 +1,79 @@
+#include "token_ring.h"
+#include "lexer.h"
+#include "parser.h"
+#include <thread>
+
+using namespace std;
+
+TokenRing::TokenRing() : head(0), tail(0), closed(false) {}
+
+bool TokenRing::push(vector<Token>& batch) {
+    size_t t = tail.load(memory_order_relaxed);
+    // Backpressure: wait for the parser to free a slot
+    while (t - head.load(memory_order_acquire) == CAPACITY) {
+        if (closed.load(memory_order_relaxed)) return false;
+        this_thread::yield();
+    }
+    slots[t & (CAPACITY - 1)].swap(batch);
+    tail.store(t + 1, memory_order_release);
+    return true;
+}
+
+void TokenRing::pop(vector<Token>& batch) {
+    size_t h = head.load(memory_order_relaxed);
+    while (tail.load(memory_order_acquire) == h) {
+        this_thread::yield();
+    }
+    batch.swap(slots[h & (CAPACITY - 1)]);
+    head.store(h + 1, memory_order_release);
+}
+
+void TokenRing::close() {
+    closed.store(true, memory_order_relaxed);
+}
+
+PipelinedParse::PipelinedParse(const string& text, const ParseLimits& parseLimits)
+    : input(text), limits(parseLimits) {}
+
+static void produceTokens(const string* input, TokenRing* ring) {
+    Lexer lexer(*input);
+    vector<Token> batch;
+    batch.reserve(TokenRing::BATCH_TOKENS);
+    for (;;) {
+        Token tok = lexer.nextToken();
+        // The parser skips newlines, so they never cross the ring
+        if (tok.type != TOK_NEWLINE) batch.push_back(tok);
+        if (tok.type == TOK_EOF || batch.size() == TokenRing::BATCH_TOKENS) {
+            if (!ring->push(batch)) return;
+            if (tok.type == TOK_EOF) return;
+            batch.clear(); // swapped-in vector from a consumed slot
+            batch.reserve(TokenRing::BATCH_TOKENS);
+        }
+    }
+}
+
+ASTNode* PipelinedParse::parseProgram() {
+    checkSourceSize(input.size()); // here rather than in the lexer thread
+    if (input.size() < MIN_PIPELINE_BYTES) {
+        Parser parser(input);
+        parser.setLimits(limits);
+        return parser.parseProgram();
+    }
+
+    TokenRing ring;
+    thread producer(produceTokens, &input, &ring);
+    ASTNode* ast = nullptr;
+    try {
+        Parser parser(ring);
+        parser.setLimits(limits);
+        ast = parser.parseProgram();
+    } catch (...) {
+        ring.close();
+        producer.join();
+        throw;
+    }
+    // Release the producer if the parser stopped before EOF
+    ring.close();
+    producer.join();
+    return ast;
+}
@@ -0,0 +1,151 @@
+#include "trace.h"
+#include "json_writer.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+bool Tracer::on = false;
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    int file; // into the thread's files, -1 for none
+    string detail;
+    uint64_t start, duration; // nanoseconds since enable()
+};
+
+// Written only by its own thread until write() reads it after the joins
+struct ThreadBuffer {
+    unsigned tid;
+    string name;
+    vector<TraceEvent> events;
+    vector<string> files;
+    int file;
+};
+
+mutex registryMutex;
+vector<unique_ptr<ThreadBuffer> > registry; // kept to the end, so spans outlive their threads
+chrono::steady_clock::time_point epoch;
+thread_local ThreadBuffer* threadBuffer = nullptr;
+
+ThreadBuffer& buffer() {
+    if (!threadBuffer) {
+        lock_guard<mutex> lock(registryMutex);
+        ThreadBuffer* created = new ThreadBuffer();
+        created->tid = (unsigned)registry.size() + 1;
+        created->name = "thread " + to_string(created->tid);
+        created->file = -1;
+        created->events.reserve(1024);
+        registry.push_back(unique_ptr<ThreadBuffer>(created));
+        threadBuffer = created;
+    }
+    return *threadBuffer;
+}
+
+uint64_t now() {
+    return (uint64_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+}
+
+// Microseconds, the unit of ts and dur
+void writeMicros(JsonWriter& json, uint64_t nanos) {
+    char text[32];
+    int size = snprintf(text, sizeof(text), "%llu.%03llu", (unsigned long long)(nanos / 1000),
+                        (unsigned long long)(nanos % 1000));
+    json.raw(text, (size_t)size);
+}
+
+} // namespace
+
+void Tracer::enable() {
+    epoch = chrono::steady_clock::now();
+    on = true;
+    nameThread("main");
+}
+
+void Tracer::nameThread(const string& name) {
+    if (on) buffer().name = name;
+}
+
+bool Tracer::write(const string& path) {
+    ofstream out(path.c_str(), ios::binary);
+    if (!out) return false;
+    JsonWriter json(out);
+    json.raw("{\"traceEvents\":[\n");
+    bool first = true;
+    lock_guard<mutex> lock(registryMutex);
+    for (size_t t = 0; t < registry.size(); t++) {
+        const ThreadBuffer& thread = *registry[t];
+        string tid = to_string(thread.tid);
+        json.raw(first ? "" : ",\n");
+        first = false;
+        json.raw("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":");
+        json.raw(tid.c_str());
+        json.raw(",\"args\":{\"name\":");
+        json.string(thread.name);
+        json.raw("}}");
+        for (size_t i = 0; i < thread.events.size(); i++) {
+            const TraceEvent& e = thread.events[i];
+            json.raw(",\n{\"ph\":\"X\",\"name\":");
+            json.string(e.name);
+            json.raw(",\"cat\":");
+            json.string(e.category);
+            json.raw(",\"pid\":1,\"tid\":");
+            json.raw(tid.c_str());
+            json.raw(",\"ts\":");
+            writeMicros(json, e.start);
+            json.raw(",\"dur\":");
+            writeMicros(json, e.duration);
+            if (e.file >= 0 || !e.detail.empty()) {
+                json.raw(",\"args\":{");
+                if (e.file >= 0) {
+                    json.raw("\"file\":");
+                    json.string(thread.files[e.file]);
+                }
+                if (!e.detail.empty()) {
+                    json.raw(e.file >= 0 ? ",\"name\":" : "\"name\":");
+                    json.string(e.detail);
+                }
+                json.raw("}");
+            }
+            json.raw("}");
+        }
+    }
+    json.raw("\n]}\n");
+    json.flush();
+    return (bool)out;
+}
+
+Tracer::FileScope::FileScope(const string& file) : previous(-1) {
+    if (!on) return;
+    ThreadBuffer& b = buffer();
+    previous = b.file;
+    b.file = (int)b.files.size();
+    b.files.push_back(file);
+}
+
+Tracer::FileScope::~FileScope() {
+    if (on) buffer().file = previous;
+}
+
+void TraceSpan::begin(const char* name, const char* category) {
+    ThreadBuffer& b = buffer();
+    index = (long)b.events.size();
+    TraceEvent e = {name, category, b.file, string(), now(), 0};
+    b.events.push_back(e);
+}
+
+void TraceSpan::end() {
+    TraceEvent& e = threadBuffer->events[index];
+    e.duration = now() - e.start;
+}
+
+void TraceSpan::setDetail(const string& detail) {
+    if (index >= 0) threadBuffer->events[index].detail = detail;
+}
@@ -0,0 +1,266 @@
+#include "tree_bundle.h"
+#include "source_files.h"
+#include "parser.h"
+#include "node_arena.h"
+#include "json_writer.h"
+#include "trace.h"
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static const char HEADER_MAGIC[] = "WZBUNDL1";
+static const char FOOTER_MAGIC[] = "WZBIDX01";
+static const size_t HEADER_BYTES = 16;
+static const size_t ENTRY_BYTES = 40;
+static const size_t FOOTER_BYTES = 32;
+
+// Rendered files a worker may run ahead of the writer
+static const size_t WINDOW = 64;
+
+uint64_t bundleHash(const char* data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static void put64(string& out, uint64_t value) {
+    for (int i = 0; i < 8; i++) out.push_back((char)(value >> (8 * i)));
+}
+
+static void put32(string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out.push_back((char)(value >> (8 * i)));
+}
+
+static uint64_t get64(const char* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = (value << 8) | (unsigned char)p[i];
+    return value;
+}
+
+static uint32_t get32(const char* p) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) value = (value << 8) | (unsigned char)p[i];
+    return value;
+}
+
+namespace {
+
+// A file's tree as the writer needs it
+struct Rendered {
+    bool ready;
+    string text;
+    string error; // set instead of text if the file failed
+};
+
+struct IndexEntry {
+    size_t file;
+    uint64_t offset, length, hash;
+};
+
+void render(const string& path, BundleFormat format, NodeArena& arena, Rendered& result) {
+    Tracer::FileScope traced(path);
+    string source;
+    ostringstream out;
+    try {
+        if (!readSourceFile(path, source)) {
+            result.error = "cannot read " + path;
+            return;
+        }
+        NodeArena::Scope scope(arena);
+        ASTNode* ast;
+        {
+            TraceSpan span("parse", "parse");
+            Parser parser(source);
+            ast = parser.parseProgram();
+        }
+        if (!ast) {
+            result.error = "parse error";
+        } else {
+            // Byte for byte what -ast or -json prints for the file
+            TraceSpan span("print", "print");
+            if (format == BUNDLE_JSON) {
+                writeJsonTree(ast, out);
+            } else {
+                ast->print(0, true, out);
+                out << "\n";
+            }
+        }
+    } catch (const exception& e) {
+        result.error = e.what();
+    }
+    arena.reset();
+    if (result.error.empty()) result.text = out.str();
+}
+
+}
+
+size_t writeBundle(const vector<string>& files, const string& archive, BundleFormat format, unsigned threads,
+                   ostream& report) {
+    ofstream out(archive.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out) throw runtime_error("cannot write " + archive);
+    string header(HEADER_MAGIC, 8);
+    put64(header, (uint64_t)format);
+    out.write(header.data(), header.size());
+    uint64_t offset = HEADER_BYTES;
+
+    // Workers claim files in order, at most WINDOW ahead of the writer,
+    // which takes each one as soon as it and those before it are done
+    vector<Rendered> results(files.size());
+    mutex lock;
+    condition_variable changed;
+    size_t claimed = 0, written = 0;
+    auto worker = [&]() {
+        Tracer::nameThread("bundle worker");
+        NodeArena arena;
+        for (;;) {
+            size_t i;
+            {
+                unique_lock<mutex> held(lock);
+                changed.wait(held, [&]() { return claimed >= files.size() || claimed < written + WINDOW; });
+                if (claimed >= files.size()) return;
+                i = claimed++;
+            }
+            Rendered done;
+            render(files[i], format, arena, done);
+            lock_guard<mutex> held(lock);
+            results[i].text.swap(done.text);
+            results[i].error.swap(done.error);
+            results[i].ready = true;
+            changed.notify_all();
+        }
+    };
+    if (threads < 1) threads = 1;
+    vector<thread> pool;
+    for (unsigned t = 0; t < threads && t < files.size(); t++) pool.push_back(thread(worker));
+
+    vector<IndexEntry> index;
+    for (size_t i = 0; i < files.size(); i++) {
+        string text, error;
+        {
+            unique_lock<mutex> held(lock);
+            changed.wait(held, [&]() { return results[i].ready; });
+            text.swap(results[i].text);
+            error.swap(results[i].error);
+            written = i + 1;
+            changed.notify_all();
+        }
+        if (!error.empty()) {
+            report << "skipped " << files[i] << ": " << error << "\n";
+            continue;
+        }
+        TraceSpan span("write", "io");
+        IndexEntry entry = {i, offset, text.size(), bundleHash(text.data(), text.size())};
+        index.push_back(entry);
+        out.write(text.data(), text.size());
+        offset += text.size();
+    }
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+
+    // Twice as many slots as entries keeps probe runs short
+    size_t tableSize = 1;
+    while (tableSize < index.size() * 2) tableSize *= 2;
+    vector<uint32_t> slots(tableSize, 0);
+    string trailer, paths;
+    for (size_t e = 0; e < index.size(); e++) {
+        const string& path = files[index[e].file];
+        put64(trailer, index[e].offset);
+        put64(trailer, index[e].length);
+        put64(trailer, index[e].hash);
+        put64(trailer, paths.size());
+        put32(trailer, (uint32_t)path.size());
+        put32(trailer, 0);
+        paths += path;
+        size_t s = bundleHash(path.data(), path.size()) & (tableSize - 1);
+        while (slots[s]) s = (s + 1) & (tableSize - 1);
+        slots[s] = (uint32_t)e + 1;
+    }
+    for (size_t s = 0; s < tableSize; s++) put32(trailer, slots[s]);
+    trailer += paths;
+    trailer.append(FOOTER_MAGIC, 8);
+    put64(trailer, offset);
+    put64(trailer, index.size());
+    put64(trailer, tableSize);
+    out.write(trailer.data(), trailer.size());
+    out.close();
+    if (!out) throw runtime_error("cannot write " + archive);
+    return index.size();
+}
+
+BundleReader::BundleReader(const string& archive) : base(nullptr), mapped(0) {
+    int fd = open(archive.c_str(), O_RDONLY);
+    if (fd < 0) throw runtime_error("cannot open " + archive);
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < HEADER_BYTES + FOOTER_BYTES) {
+        close(fd);
+        throw runtime_error(archive + " is not a tree bundle");
+    }
+    mapped = (size_t)info.st_size;
+    void* view = mmap(nullptr, mapped, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) throw runtime_error("cannot map " + archive);
+    base = static_cast<const char*>(view);
+
+    const char* footer = base + mapped - FOOTER_BYTES;
+    uint64_t indexOffset = get64(footer + 8);
+    count = (size_t)get64(footer + 16);
+    tableSize = (size_t)get64(footer + 24);
+    uint64_t tableEnd = indexOffset + count * ENTRY_BYTES + tableSize * 4;
+    bool valid = memcmp(base, HEADER_MAGIC, 8) == 0 && memcmp(footer, FOOTER_MAGIC, 8) == 0 &&
+                 indexOffset >= HEADER_BYTES && indexOffset < mapped && count < mapped && tableSize < mapped &&
+                 tableEnd <= mapped - FOOTER_BYTES && (tableSize & (tableSize - 1)) == 0 && tableSize >= count;
+    if (!valid) {
+        munmap(const_cast<char*>(base), mapped);
+        throw runtime_error(archive + " is not a tree bundle");
+    }
+    kind = get64(base + 8) == BUNDLE_JSON ? BUNDLE_JSON : BUNDLE_TEXT;
+    entries = base + indexOffset;
+    slots = entries + count * ENTRY_BYTES;
+    paths = slots + tableSize * 4;
+    pathBytes = (size_t)(mapped - FOOTER_BYTES - tableEnd);
+}
+
+BundleReader::~BundleReader() {
+    munmap(const_cast<char*>(base), mapped);
+}
+
+BundleReader::Entry BundleReader::entry(size_t i) const {
+    const char* record = entries + i * ENTRY_BYTES;
+    uint64_t offset = get64(record), length = get64(record + 8);
+    uint64_t pathOffset = get64(record + 24);
+    uint32_t pathLength = get32(record + 32);
+    if (offset > mapped || length > mapped - offset || pathOffset > pathBytes || pathLength > pathBytes - pathOffset) {
+        throw runtime_error("corrupt bundle entry " + to_string(i));
+    }
+    Entry result;
+    result.path.assign(paths + pathOffset, pathLength);
+    result.data = base + offset;
+    result.length = (size_t)length;
+    result.hash = get64(record + 16);
+    return result;
+}
+
+bool BundleReader::find(const string& path, Entry& result) const {
+    if (!tableSize) return false;
+    size_t mask = tableSize - 1;
+    size_t s = bundleHash(path.data(), path.size()) & mask;
+    for (size_t probes = 0; probes < tableSize; probes++, s = (s + 1) & mask) {
+        uint32_t slot = get32(slots + s * 4);
+        if (!slot || slot > count) return false;
+        result = entry(slot - 1);
+        if (result.path == path) return true;
+    }
+    return false;
+}
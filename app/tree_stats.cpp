@@ -0,0 +1,139 @@
+#include "tree_stats.h"
+#include "ast_visitor.h"
+#include "symbols.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+// Counts every node it walks into a TreeStats
+class StatsPass : public AstVisitor<StatsPass> {
+public:
+    explicit StatsPass(TreeStats& result) : stats(result) {}
+
+    VisitAction pre(const ASTNode* node, int depth) {
+        stats.nodes++;
+        stats.kinds[node->kind]++;
+        stats.categories[nodeCategory(node->kind)]++;
+        if (depth > stats.depth) stats.depth = depth;
+        // Functions are counted separately, possibly in parallel
+        return node->kind == NK_SUBPROGS ? SKIP_CHILDREN : VISIT_CHILDREN;
+    }
+
+private:
+    TreeStats& stats;
+};
+
+static void clearStats(TreeStats& stats) {
+    stats.nodes = 0;
+    stats.depth = 0;
+    memset(stats.kinds, 0, sizeof(stats.kinds));
+    memset(stats.categories, 0, sizeof(stats.categories));
+    stats.functions.clear();
+}
+
+TreeStats collectTreeStats(const ASTNode* program, unsigned threads) {
+    TraceSpan span("stats", "semantic");
+    TreeStats total;
+    clearStats(total);
+    StatsPass(total).walk(program);
+
+    // One slot per function, filled by whichever worker takes it
+    const ASTNode* subprogs = findSubprogs(program);
+    vector<TreeStats> perFunction(subprogs ? subprogs->children.size() : 0);
+    parallelForFunctions(program, threads, [&perFunction](const ASTNode* fcn, size_t index) {
+        TreeStats& stats = perFunction[index];
+        clearStats(stats);
+        StatsPass(stats).walk(fcn, 2); // program/subprogs/fcn
+    });
+
+    for (size_t i = 0; i < perFunction.size(); i++) {
+        const TreeStats& stats = perFunction[i];
+        total.nodes += stats.nodes;
+        total.depth = max(total.depth, stats.depth);
+        for (int k = 0; k < NK_KIND_COUNT; k++) total.kinds[k] += stats.kinds[k];
+        for (int c = 0; c <= CAT_OTHER; c++) total.categories[c] += stats.categories[c];
+
+        FunctionStats fn;
+        fn.name = leafText(subprogs->children[i]->children[0]);
+        fn.nodes = stats.nodes;
+        fn.depth = stats.depth;
+        fn.statements = stats.categories[CAT_STATEMENT];
+        fn.calls = stats.kinds[NK_CALL];
+        total.functions.push_back(fn);
+    }
+    return total;
+}
+
+void printTreeStats(const TreeStats& stats, ostream& out) {
+    out << "nodes: " << stats.nodes << "\n";
+    out << "max depth: " << stats.depth << "\n";
+    out << "declarations: " << stats.categories[CAT_DECLARATION] << "\n";
+    out << "statements: " << stats.categories[CAT_STATEMENT] << "\n";
+    out << "literals: " << stats.categories[CAT_LITERAL] << "\n";
+    out << "expressions: " << stats.categories[CAT_EXPRESSION] << "\n";
+    out << "text: " << stats.categories[CAT_OTHER] << "\n";
+
+    // Most frequent kinds first
+    vector<pair<size_t, int> > kinds;
+    for (int k = 0; k < NK_KIND_COUNT; k++) {
+        if (stats.kinds[k]) kinds.push_back(make_pair(stats.kinds[k], k));
+    }
+    sort(kinds.begin(), kinds.end(), [](const pair<size_t, int>& a, const pair<size_t, int>& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    out << "kinds:\n";
+    for (size_t i = 0; i < kinds.size(); i++) {
+        out << "  " << nodeKindName((NodeKind)kinds[i].second) << " " << kinds[i].first << "\n";
+    }
+
+    out << "functions: " << stats.functions.size() << "\n";
+    for (size_t i = 0; i < stats.functions.size(); i++) {
+        const FunctionStats& fn = stats.functions[i];
+        out << "  " << fn.name << ": " << fn.nodes << " nodes, depth " << fn.depth << ", " << fn.statements
+            << " statements, " << fn.calls << " calls\n";
+    }
+}
+
+static const char* const declarationNames[] = {
+    "program", "consts", "const", "types", "type", "lit", "dclns", "var", "subprogs", "fcn", "params"
+};
+static const char* const statementNames[] = {
+    "block", "assign", "swap", "output", "if", "while", "repeat", "for", "loop", "case", "case_clause",
+    "..", "otherwise", "read", "exit", "return", "<null>", "integer", "string"
+};
+static const char* const literalNames[] = {"<identifier>", "<integer>", "<char>", "<string>", "true"};
+static const char* const expressionNames[] = {
+    "<=", "<", ">=", ">", "=", "<>", "+", "-", "or", "*", "/", "and", "mod", "not", "succ", "pred",
+    "chr", "ord", "eof", "call"
+};
+
+template <size_t N>
+static bool nameIn(const string& type, const char* const (&names)[N]) {
+    for (size_t i = 0; i < N; i++) {
+        if (type == names[i]) return true;
+    }
+    return false;
+}
+
+static void countByName(const ASTNode* node, bool text, size_t categories[]) {
+    const string& type = node->nodeType;
+    NodeCategory category = CAT_OTHER;
+    if (!text) {
+        if (nameIn(type, declarationNames)) category = CAT_DECLARATION;
+        else if (nameIn(type, statementNames)) category = CAT_STATEMENT;
+        else if (nameIn(type, literalNames)) category = CAT_LITERAL;
+        else if (nameIn(type, expressionNames)) category = CAT_EXPRESSION;
+    }
+    categories[category]++;
+
+    // The children of literal wrappers are source text
+    bool wrapper = category == CAT_LITERAL && type != "true";
+    for (size_t i = 0; i < node->children.size(); i++) countByName(node->children[i], wrapper, categories);
+}
+
+void countCategoriesByName(const ASTNode* root, size_t categories[]) {
+    for (int c = 0; c <= CAT_OTHER; c++) categories[c] = 0;
+    countByName(root, false, categories);
+}
@@ -0,0 +1,192 @@
+#include "winzig.h"
+#include <new>
+#include <streambuf>
+#include <ostream>
+#include <string>
+#include "parser.h"
+#include "node_arena.h"
+#include "json_writer.h"
+
+using namespace std;
+
+// Owns one parse: its arena holds every node, so freeing is one reset
+struct winzig_tree {
+    NodeArena arena;
+    ASTNode* root;
+    string error;
+
+    winzig_tree() : root(nullptr) {}
+};
+
+// Node handles are the nodes themselves; the struct is never defined
+static const ASTNode* unwrap(const winzig_node* node) {
+    return reinterpret_cast<const ASTNode*>(node);
+}
+
+static const winzig_node* wrap(const ASTNode* node) {
+    return reinterpret_cast<const winzig_node*>(node);
+}
+
+namespace {
+
+// Writes into the caller's buffer up to its capacity and keeps counting
+// past it, so a truncated render still reports the size it needs
+class BoundedBuffer : public streambuf {
+public:
+    BoundedBuffer(char* buffer, size_t capacity)
+        : dest(buffer), room(capacity ? capacity - 1 : 0), total(0) {}
+
+    size_t size() const { return total; }
+
+    void terminate() {
+        if (dest) dest[total < room ? total : room] = '\0';
+    }
+
+protected:
+    int overflow(int c) {
+        if (c == EOF) return 0;
+        if (total < room) dest[total] = (char)c;
+        total++;
+        return c;
+    }
+
+    streamsize xsputn(const char* text, streamsize count) {
+        size_t n = (size_t)count;
+        if (total < room) {
+            size_t copied = n < room - total ? n : room - total;
+            char_traits<char>::copy(dest + total, text, copied);
+        }
+        total += n;
+        return count;
+    }
+
+private:
+    char* dest;
+    size_t room;
+    size_t total;
+};
+
+}
+
+extern "C" {
+
+int winzig_api_version(void) {
+    return WINZIG_API_VERSION;
+}
+
+void winzig_default_limits(winzig_limits* limits) {
+    if (!limits) return;
+    ParseLimits defaults;
+    limits->max_depth = defaults.maxDepth;
+    limits->max_nodes = defaults.maxNodes;
+    limits->max_arena_bytes = defaults.maxArenaBytes;
+}
+
+winzig_status winzig_parse(const char* source, size_t length, const winzig_limits* limits, winzig_tree** tree) {
+    if (!tree) return WINZIG_ERR_ARGUMENT;
+    *tree = nullptr;
+    if (!source && length) return WINZIG_ERR_ARGUMENT;
+
+    winzig_tree* result = new (nothrow) winzig_tree;
+    if (!result) return WINZIG_ERR_MEMORY;
+    *tree = result;
+
+    winzig_status status = WINZIG_OK;
+    try {
+        checkSourceSize(length); // before copying it
+        ParseLimits parseLimits;
+        if (limits) {
+            parseLimits.maxDepth = limits->max_depth;
+            parseLimits.maxNodes = limits->max_nodes;
+            parseLimits.maxArenaBytes = limits->max_arena_bytes;
+        }
+        result->arena.setLimits(parseLimits);
+        // The arena is active only on this thread, so parses on other
+        // threads allocate from their own trees
+        NodeArena::Scope scope(result->arena);
+        Parser parser(string(source ? source : "", length));
+        parser.setLimits(parseLimits);
+        result->root = parser.parseProgram();
+        if (!result->root) {
+            status = WINZIG_ERR_SYNTAX;
+            result->error = "Parse error";
+        } else if (!parser.complete()) {
+            // The parser recovers from missing tokens; the API does not
+            status = WINZIG_ERR_SYNTAX;
+            result->error = "Parse error: input ends before the program does, or continues after its '.'";
+        }
+    } catch (const ResourceLimitError& e) {
+        status = WINZIG_ERR_LIMIT;
+        result->error = e.what();
+    } catch (const bad_alloc&) {
+        status = WINZIG_ERR_MEMORY;
+        result->error = "out of memory";
+    } catch (const exception& e) {
+        status = WINZIG_ERR_SYNTAX;
+        result->error = e.what();
+    }
+
+    if (status != WINZIG_OK) {
+        // Keep only the message
+        result->root = nullptr;
+        result->arena.reset();
+    }
+    return status;
+}
+
+void winzig_free(winzig_tree* tree) {
+    delete tree;
+}
+
+const char* winzig_error(const winzig_tree* tree) {
+    return tree ? tree->error.c_str() : "";
+}
+
+const winzig_node* winzig_root(const winzig_tree* tree) {
+    return tree ? wrap(tree->root) : nullptr;
+}
+
+size_t winzig_node_count(const winzig_tree* tree) {
+    return tree && tree->root ? tree->arena.nodeCount() : 0;
+}
+
+const char* winzig_node_type(const winzig_node* node) {
+    return node ? unwrap(node)->nodeType.c_str() : "";
+}
+
+size_t winzig_node_child_count(const winzig_node* node) {
+    return node ? unwrap(node)->children.size() : 0;
+}
+
+const winzig_node* winzig_node_child(const winzig_node* node, size_t index) {
+    if (!node || index >= unwrap(node)->children.size()) return nullptr;
+    return wrap(unwrap(node)->children[index]);
+}
+
+winzig_status winzig_render(const winzig_node* node, winzig_format format, char* buffer, size_t capacity,
+                            size_t* needed) {
+    if (needed) *needed = 0;
+    if (!node || (!buffer && capacity) || (format != WINZIG_FORMAT_AST && format != WINZIG_FORMAT_JSON)) {
+        return WINZIG_ERR_ARGUMENT;
+    }
+
+    BoundedBuffer bounded(buffer, capacity);
+    try {
+        ostream out(&bounded);
+        if (format == WINZIG_FORMAT_AST) {
+            unwrap(node)->print(0, true, out);
+            out << "\n";
+        } else {
+            writeJsonTree(unwrap(node), out);
+        }
+        out.flush();
+    } catch (const bad_alloc&) {
+        bounded.terminate();
+        return WINZIG_ERR_MEMORY;
+    }
+    bounded.terminate();
+    if (needed) *needed = bounded.size();
+    return capacity > bounded.size() ? WINZIG_OK : WINZIG_ERR_TRUNCATED;
+}
+
+}
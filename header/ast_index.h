@@ -0,0 +1,77 @@
+#ifndef AST_INDEX_H
+#define AST_INDEX_H
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ast_node.h"
+
+// Compiled form of a path pattern such as fcn/block//call[identifier=IsPrime]
+//   a/b               b is a child of a
+//   a//b              b is a descendant of a
+//   /program/...      a leading '/' anchors the first step at the root
+//   *                 any node kind, never the text under a literal
+//   identifier        kinds may omit their angle brackets (<identifier>)
+//   [identifier=X]    the node has an <identifier> child named X
+//   [//identifier=X]  the node has an <identifier> descendant named X
+//   [=X]              the node's own text is X, e.g. identifier[=X]
+// Throws runtime_error on a malformed pattern.
+class AstQuery {
+public:
+    explicit AstQuery(const std::string& pattern);
+
+    struct Step {
+        bool descendant;  // reached through // rather than /
+        std::string kind; // empty for *
+        std::string childName;
+        std::string descendantName;
+        std::string text;
+    };
+
+    bool anchored;
+    std::vector<Step> steps;
+};
+
+// Preorder numbering of a tree with per-kind and per-identifier posting
+// lists, built in one walk. Queries start from the posting list of their
+// last step and check the rest of the path by walking parent links, so
+// their cost follows the number of candidates rather than the tree size.
+// The tree must outlive the index and stay unmodified.
+class AstIndex {
+public:
+    typedef uint32_t NodeId;
+
+    explicit AstIndex(const ASTNode* root);
+
+    std::vector<const ASTNode*> query(const std::string& pattern) const;
+    std::vector<NodeId> find(const AstQuery& query) const;
+
+    // Sorted preorder ids of every node of a kind / every <identifier> named name
+    const std::vector<NodeId>& nodesOfKind(const std::string& kind) const;
+    const std::vector<NodeId>& identifierUses(const std::string& name) const;
+
+    size_t size() const { return nodes.size(); }
+    const ASTNode* node(NodeId id) const { return nodes[id]; }
+    NodeId parent(NodeId id) const { return parents[id]; }
+    // Path from the root with child positions, e.g. program/subprogs[4]/fcn[0]
+    std::string path(NodeId id) const;
+
+private:
+    static const NodeId NONE = 0xffffffffu;
+
+    std::vector<const ASTNode*> nodes;
+    std::vector<NodeId> parents;
+    std::vector<NodeId> ends;      // one past the last id in each subtree
+    std::vector<uint32_t> positions; // index among the parent's children
+    std::unordered_map<std::string, std::vector<NodeId> > kinds;
+    std::unordered_map<std::string, std::vector<NodeId> > identifiers;
+    std::vector<NodeId> noNodes;
+
+    void build(const ASTNode* root);
+    std::string resolveKind(const std::string& kind) const;
+    bool stepMatches(const AstQuery::Step& step, NodeId id) const;
+    bool matchesUpward(const AstQuery& query, size_t step, NodeId id) const;
+};
+
+#endif // AST_INDEX_H
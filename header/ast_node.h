@@ -1,21 +1,31 @@
 #ifndef AST_NODE_H
 #define AST_NODE_H
 
+#include <cstddef>
 #include <iostream>
 #include <vector>
 #include <string>
+#include "node_kind.h"
 
 class ASTNode {
 public:
     std::string nodeType;
     std::vector<ASTNode*> children;
     std::string value;
+    size_t structuralHash; // set once interned by a NodeInterner, else 0
+    NodeKind kind;
     
     ASTNode(const std::string& type, const std::string& val = "") 
-        : nodeType(type), value(val) {}
+        : nodeType(type), value(val), structuralHash(0), kind(classifyNodeType(type)) {}
+    ASTNode(const std::string& type, NodeKind nodeKind)
+        : nodeType(type), structuralHash(0), kind(nodeKind) {}
     
     void addChild(ASTNode* child);
-    void print(int depth = 0, bool isLast = false) const;
+    void print(int depth = 0, bool isLast = false, std::ostream& out = std::cout) const;
+    
+    // Allocate from the thread's active NodeArena, if any
+    static void* operator new(size_t bytes);
+    static void operator delete(void* p);
 };
 
 #endif // AST_NODE_H
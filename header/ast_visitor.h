@@ -0,0 +1,66 @@
+#ifndef AST_VISITOR_H
+#define AST_VISITOR_H
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "ast_node.h"
+
+enum VisitAction { VISIT_CHILDREN, SKIP_CHILDREN };
+
+// Base for tree passes using static dispatch. A pass derives from
+// AstVisitor<Pass> and defines any of
+//   VisitAction pre(const ASTNode* node, int depth);  // before the children
+//   void post(const ASTNode* node, int depth);        // after them
+// The calls are resolved at compile time, so the hooks inline into the walk,
+// and hooks switch on node->kind rather than comparing nodeType strings.
+// Returning SKIP_CHILDREN from pre leaves the subtree out; post still runs
+// for that node.
+template <class Derived>
+class AstVisitor {
+public:
+    void walk(const ASTNode* node, int depth = 0) {
+        Derived& self = static_cast<Derived&>(*this);
+        if (self.pre(node, depth) == VISIT_CHILDREN) {
+            for (size_t i = 0; i < node->children.size(); i++) walk(node->children[i], depth + 1);
+        }
+        self.post(node, depth);
+    }
+
+    // Defaults for the hooks a pass leaves out
+    VisitAction pre(const ASTNode*, int) { return VISIT_CHILDREN; }
+    void post(const ASTNode*, int) {}
+};
+
+// The subprogs node of a program, or null
+inline const ASTNode* findSubprogs(const ASTNode* program) {
+    for (size_t i = 0; i < program->children.size(); i++) {
+        if (program->children[i]->kind == NK_SUBPROGS) return program->children[i];
+    }
+    return nullptr;
+}
+
+// Calls fn(fcn, index) for every function of a program on up to threads
+// workers, handing functions out one at a time. fn must be safe to call
+// concurrently; passes usually keep one result slot per index.
+template <class Fn>
+void parallelForFunctions(const ASTNode* program, unsigned threads, Fn fn) {
+    const ASTNode* subprogs = findSubprogs(program);
+    if (!subprogs) return;
+    const std::vector<ASTNode*>& fcns = subprogs->children;
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next.fetch_add(1); i < fcns.size(); i = next.fetch_add(1)) fn(fcns[i], i);
+    };
+    unsigned count = threads < fcns.size() ? threads : (unsigned)fcns.size();
+    if (count <= 1) {
+        worker();
+        return;
+    }
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < count; t++) pool.push_back(std::thread(worker));
+    for (size_t t = 0; t < pool.size(); t++) pool[t].join();
+}
+
+#endif // AST_VISITOR_H
@@ -0,0 +1,39 @@
+#ifndef C_EMITTER_H
+#define C_EMITTER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ast_node.h"
+#include "symbols.h"
+
+// Translates a parsed program into a self-contained C99 translation unit.
+// The generated code follows the same runtime semantics as the Interpreter:
+// 32-bit wrapping integer arithmetic, one output item per line, and
+// whitespace-skipping read/eof on stdin.
+class CEmitter {
+private:
+    std::ostream& out;
+    const ProgramInfo& info;
+    const FunctionInfo* current;
+    int labelCounter;
+    int tempCounter; // sequencing temporaries used by the current function
+    std::vector<int> exitLabels; // innermost loop/pool exit label last
+
+    void emitRuntime();
+    void emitFunction(const FunctionInfo& fn);
+    void emitStatement(const ASTNode* stmt, int indent);
+    void emitCase(const ASTNode* caseNode, int indent);
+    void emitRead(const ASTNode* read, int indent);
+    std::string expr(const ASTNode* node);
+    std::string sequenced(const std::vector<const ASTNode*>& operands,
+                          std::vector<std::string>& values);
+    std::string variable(const ASTNode* identifier);
+    std::string pad(int indent) const;
+
+public:
+    CEmitter(std::ostream& os, const ProgramInfo& programInfo);
+    void emit(const ASTNode* program);
+};
+
+#endif // C_EMITTER_H
@@ -0,0 +1,44 @@
+#ifndef CALL_GRAPH_H
+#define CALL_GRAPH_H
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ast_node.h"
+
+// Which function calls which, in compressed sparse row form: the distinct
+// callees of function f are callees[calleeStart[f]] .. callees[calleeStart[f + 1] - 1].
+// Functions are numbered in subprogs order and calls resolve by name the
+// way ProgramInfo does, so with duplicate names the last one wins.
+struct CallGraph {
+    std::vector<std::string> names;
+    std::vector<const ASTNode*> fcns;
+    std::vector<uint32_t> calleeStart, callees;
+    std::vector<uint32_t> roots;           // functions the main block calls
+    std::vector<std::string> unresolved;   // called names that are not functions, sorted
+
+    size_t functionCount() const { return names.size(); }
+    size_t edgeCount() const { return callees.size(); }
+};
+
+// Collects the calls of every function on up to threads workers
+CallGraph buildCallGraph(const ASTNode* program, unsigned threads);
+
+// Functions reachable from the main block, one flag per function, found
+// by a breadth-first search that expands wide levels in parallel
+std::vector<char> reachableFunctions(const CallGraph& graph, unsigned threads);
+
+// Strongly connected components that recurse: more than one function, or
+// one that calls itself. Members and components are in function order.
+std::vector<std::vector<uint32_t> > recursiveComponents(const CallGraph& graph);
+
+// A copy of the program without the unreachable functions. Only the
+// program and subprogs nodes are new; everything else is shared with the
+// original tree.
+ASTNode* pruneUnreachable(const ASTNode* program, const CallGraph& graph, const std::vector<char>& reachable);
+
+void printCallGraphReport(const CallGraph& graph, const std::vector<char>& reachable,
+                          const std::vector<std::vector<uint32_t> >& recursive, std::ostream& out);
+
+#endif // CALL_GRAPH_H
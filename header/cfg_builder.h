@@ -0,0 +1,67 @@
+#ifndef CFG_BUILDER_H
+#define CFG_BUILDER_H
+
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ast_node.h"
+#include "symbols.h"
+
+enum CfgOp {
+    CFG_PHI,    // one use per predecessor, in predecessor order
+    CFG_ASSIGN,
+    CFG_SWAP,   // defines both operands from each other's old values
+    CFG_READ,
+    CFG_OUTPUT,
+    CFG_BRANCH, // successors: true, false
+    CFG_SWITCH, // successors: one per case clause, then otherwise or fall-through
+    CFG_RETURN
+};
+
+struct CfgInstr {
+    CfgOp op;
+    const ASTNode* node; // the statement, condition or selector; null for phis
+};
+
+// One function, or the main block, as a control-flow graph in SSA form.
+// Everything is stored in flat arrays with index-based edges; a list per
+// block or instruction is a range of a shared array, e.g. block b's
+// successors are succ[succStart[b]] .. succ[succStart[b + 1] - 1].
+// Block 0 is the entry and block 1 the exit. SSA values 0 .. vars.size()-1
+// are the variables' values on entry (parameters, or undefined/zero).
+// Variables that a call could change (globals used by any function) are
+// left out of SSA and treated as memory.
+struct FunctionCfg {
+    static const uint32_t NONE = 0xffffffffu;
+
+    std::string name;
+
+    std::vector<uint32_t> instrStart; // per block, phis first
+    std::vector<uint32_t> succStart, succ;
+    std::vector<uint32_t> predStart, pred;
+    std::vector<uint32_t> idom;       // NONE for unreachable blocks
+
+    std::vector<CfgInstr> instrs;
+    std::vector<uint32_t> useStart, uses; // SSA values read; NONE if unreachable
+    std::vector<uint32_t> defStart, defs; // SSA values written
+
+    std::vector<std::string> vars;
+    std::vector<uint32_t> valueVar;     // variable of each SSA value
+    std::vector<uint32_t> valueVersion; // 0 for entry values
+    size_t phiCount;
+
+    size_t blockCount() const { return instrStart.size() - 1; }
+};
+
+// Lowers every function and the main block, the functions in parallel on
+// up to threads workers. The main block comes last.
+std::vector<FunctionCfg> buildProgramCfgs(const ASTNode* program, const ProgramInfo& info,
+                                          unsigned threads);
+
+// Lowers one statement tree; vars are the SSA candidates by name
+FunctionCfg buildCfg(const std::string& name, const ASTNode* body, const std::vector<std::string>& vars);
+
+void printCfg(const FunctionCfg& cfg, std::ostream& out);
+
+#endif // CFG_BUILDER_H
@@ -0,0 +1,97 @@
+#ifndef CLONE_DETECTOR_H
+#define CLONE_DETECTOR_H
+
+#include <stdint.h>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "node_kind.h"
+
+// Where a subtree was seen: the file, the subtree root's number in a
+// preorder walk of that file's tree, and the fingerprint of its parent (0
+// for the root)
+struct CloneSite {
+    uint32_t file;
+    uint32_t node;
+    uint64_t parent;
+};
+
+struct CloneGroup {
+    uint64_t fingerprint;
+    NodeKind kind;
+    uint32_t size; // nodes in each copy
+    std::vector<CloneSite> copies;
+};
+
+// Finds copy-pasted code across a corpus. Every file is parsed on a pool of
+// workers and each subtree gets a bottom-up Merkle fingerprint: a 64-bit
+// hash of its type, text and the fingerprints of its children in order.
+// Subtrees of at least minSize nodes go into an index shared by all
+// workers and split into locked shards, which keeps one entry per distinct
+// fingerprint plus one site for every further copy. Trees are dropped as
+// soon as they are indexed.
+class CloneDetector {
+public:
+    static const size_t DEFAULT_MIN_SIZE = 30;
+
+    // One subtree as the fingerprinting walk hands it to the index
+    struct Record {
+        uint64_t fingerprint;
+        uint32_t size;
+        NodeKind kind;
+        CloneSite site;
+    };
+
+    CloneDetector(const std::vector<std::string>& corpus, size_t minSize, unsigned threadCount);
+
+    // Parses and indexes every file
+    void run();
+
+    // Fingerprints seen more than once, leaving out groups whose every
+    // copy sits inside a larger clone. Largest first.
+    std::vector<CloneGroup> groups() const;
+
+    // Prints each group with the tree path of every copy, then a summary.
+    // Files are parsed again to name the paths. Returns the group count.
+    size_t report(std::ostream& out);
+
+    size_t uniqueFingerprints() const;
+    size_t indexedSubtrees() const { return indexed; }
+
+private:
+    enum { SHARDS = 64 };
+
+    struct Entry {
+        uint32_t count;
+        uint32_t size;
+        NodeKind kind;
+        CloneSite first;
+    };
+
+    struct Shard {
+        std::mutex lock;
+        std::unordered_map<uint64_t, Entry> entries;
+        std::vector<std::pair<uint64_t, CloneSite> > copies; // sites after the first
+    };
+
+    const std::vector<std::string>& files;
+    size_t minimum;
+    unsigned threads;
+    std::unique_ptr<Shard[]> shards;
+    std::vector<std::string> failures; // per file, empty if it parsed
+    size_t indexed;
+
+    void indexFiles(std::atomic<size_t>* next, size_t* count);
+    void insert(std::vector<Record>& records);
+    const Entry* find(uint64_t fingerprint) const;
+    static Shard& shardOf(Shard* shards, uint64_t fingerprint) { return shards[fingerprint >> 58]; }
+
+    CloneDetector(const CloneDetector&);
+    CloneDetector& operator=(const CloneDetector&);
+};
+
+#endif // CLONE_DETECTOR_H
@@ -0,0 +1,46 @@
+#ifndef GOLDEN_VERIFIER_H
+#define GOLDEN_VERIFIER_H
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct GoldenCase {
+    std::string name;
+    std::string inputPath;
+    std::string goldenPath;
+};
+
+// Checks -ast output against .tree goldens without leaving the process:
+// every input is parsed and rendered into memory on a pool of worker threads
+// and compared byte for byte with its golden file.
+class GoldenVerifier {
+public:
+    GoldenVerifier(const std::vector<GoldenCase>& goldenCases, unsigned threadCount);
+
+    // Parse with n-ary chains and expand them before printing, which
+    // checks the round trip to the canonical tree
+    void setFlattenChains(bool flatten) { flatChains = flatten; }
+
+    // Prints one line per failing case plus a summary; returns the number
+    // of failures
+    size_t run(std::ostream& report);
+
+    // Every findSourceFiles input under dir that has a matching <file>.tree,
+    // named by its path below dir
+    static std::vector<GoldenCase> discover(const std::string& dir);
+
+private:
+    const std::vector<GoldenCase>& cases;
+    unsigned threads;
+    bool flatChains;
+
+    void worker(std::atomic<size_t>* next, std::vector<std::string>* failures);
+};
+
+// Describes the first line where actual differs from expected, naming the
+// node by its path from the root, e.g. program/subprogs[4]/fcn[0]/block[6]
+std::string firstTreeDifference(const std::string& expected, const std::string& actual);
+
+#endif // GOLDEN_VERIFIER_H
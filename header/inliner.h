@@ -0,0 +1,56 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ast_node.h"
+
+// Substitutes the bodies of small helper functions at their call sites. A
+// callee qualifies when its body has at most maxSize nodes, it declares no
+// constants or types of its own, it is not recursive, and it is pure: it
+// reads no input, prints nothing, assigns only its own parameters and
+// locals and calls only pure functions.
+//
+// A call is expanded into statements placed before the statement that
+// evaluates it, so only calls that statement evaluates exactly once and
+// before anything with an effect are taken: in an assignment, the first
+// output item, the test of an if or repeat, a case selector, a returned
+// value or the start of a for. Loop tests of while and for, and the
+// operands of and/or after the first, are left alone.
+//
+// Parameters and locals become fresh variables declared in the caller (as
+// globals for the main block), and locals the body may read before setting
+// start at zero like a fresh frame. 'return (e)' assigns a result variable
+// that replaces the call. A body that can return from anywhere but its end
+// runs inside loop ... pool, where each return also exits.
+class Inliner {
+public:
+    static const size_t DEFAULT_MAX_SIZE = 64;
+
+    explicit Inliner(size_t maxSize = DEFAULT_MAX_SIZE);
+
+    // A copy of the program with the calls inlined. Subtrees without an
+    // inlined call are shared with the original, which is left unchanged.
+    ASTNode* run(const ASTNode* program);
+
+    // Call sites inlined in total and per callee, and the change in node count
+    void report(std::ostream& out) const;
+
+    size_t inlinedCount() const { return inlined; }
+
+private:
+    struct Expanded {
+        std::string name;
+        size_t sites;
+        size_t size; // nodes in the body
+    };
+
+    size_t maximum;
+    size_t callSites, inlined;
+    size_t nodesBefore, nodesAfter;
+    std::vector<Expanded> callees; // in function order
+};
+
+#endif // INLINER_H
@@ -0,0 +1,37 @@
+#ifndef INTERPRETER_H
+#define INTERPRETER_H
+
+#include <vector>
+#include "ast_node.h"
+#include "symbols.h"
+
+// Reference tree-walking evaluator for WinZig programs. All values are
+// 32-bit integers with wrapping arithmetic; 'output' prints one item per
+// line and 'read'/'eof' skip whitespace on stdin.
+class Interpreter {
+private:
+    enum Flow { FLOW_NORMAL, FLOW_EXIT, FLOW_RETURN };
+
+    const ASTNode* program;
+    const ProgramInfo& info;
+    std::vector<int> globals;
+    std::vector<int>* frame;
+    const FunctionInfo* current;
+    int returnValue;
+
+    Flow execute(const ASTNode* stmt);
+    Flow executeCase(const ASTNode* caseNode);
+    int evaluate(const ASTNode* expr);
+    int call(const ASTNode* callNode);
+    int& variable(const ASTNode* identifier);
+
+    int skipSpace();
+    int readInteger();
+    int readCharacter();
+
+public:
+    Interpreter(const ASTNode* root, const ProgramInfo& programInfo);
+    void run();
+};
+
+#endif // INTERPRETER_H
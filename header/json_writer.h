@@ -0,0 +1,44 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <iostream>
+#include <string>
+#include "ast_node.h"
+
+// Buffered JSON text writer. Escaping scans eight bytes at a time and only
+// drops to a per-character loop for words that contain a quote, backslash
+// or control character.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::ostream& os);
+    ~JsonWriter();
+
+    void raw(const char* text, size_t size);
+    void raw(const char* text);
+    void string(const std::string& text); // quoted and escaped
+    void flush();
+
+private:
+    enum { BUFFER_BYTES = 64 * 1024 };
+
+    std::ostream& out;
+    char buffer[BUFFER_BYTES];
+    size_t used;
+
+    void put(char c) {
+        if (used == BUFFER_BYTES) flush();
+        buffer[used++] = c;
+    }
+    void escapeByte(unsigned char c);
+
+    JsonWriter(const JsonWriter&);
+    JsonWriter& operator=(const JsonWriter&);
+};
+
+// Streams the tree as nested {"type": ..., "value": ..., "children": [...]}
+// objects in one depth-first walk, without building a JSON document first.
+// Literal wrappers such as <identifier> and <string> carry their text in
+// "value" instead of a child object.
+void writeJsonTree(const ASTNode* root, std::ostream& out);
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,54 @@
+#ifndef LAZY_BODIES_H
+#define LAZY_BODIES_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include "ast_node.h"
+#include "parse_limits.h"
+
+// Function bodies a Parser skipped (see Parser::deferBodies). Each fcn in
+// the tree holds a <lazy> placeholder where its block would be, and the
+// byte range of the body is kept here until a caller asks for it. Skipping
+// only matches begin and case against end, so syntax errors inside a body
+// surface when it is materialized. The source must outlive this object.
+// Not safe to use from several threads at once.
+class LazyBodies {
+public:
+    explicit LazyBodies(const std::string& source);
+
+    // Records the body at [begin, end) and returns its placeholder
+    ASTNode* defer(size_t begin, size_t end);
+
+    void setLimits(const ParseLimits& parseLimits) { limits = parseLimits; }
+
+    // Builds n-ary chains in bodies, as the parser that deferred them does
+    void setFlattenChains(bool enabled) { flat = enabled; }
+
+    // True while fcn's body is still a placeholder
+    bool pending(const ASTNode* fcn) const;
+
+    // Parses fcn's body into the active arena on first use, puts it in the
+    // tree and returns it
+    ASTNode* materialize(ASTNode* fcn);
+
+    // Every remaining body of the program; returns how many were parsed
+    size_t materializeAll(ASTNode* program);
+
+    size_t pendingCount() const { return ranges.size(); }
+
+private:
+    struct Range {
+        size_t begin, end;
+    };
+
+    const std::string& text;
+    std::unordered_map<const ASTNode*, Range> ranges; // by placeholder
+    ParseLimits limits;
+    bool flat;
+
+    LazyBodies(const LazyBodies&);
+    LazyBodies& operator=(const LazyBodies&);
+};
+
+#endif // LAZY_BODIES_H
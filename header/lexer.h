@@ -1,19 +1,43 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <istream>
 #include <string>
 #include <map>
+#include <vector>
 #include "token.h"
+#include "parse_limits.h"
 
+// Lexes a source held in memory, or streams one from an istream through a
+// fixed-size window that is refilled as tokens are consumed. A refill
+// keeps only the unread tail and the token being lexed, so tokens and
+// comments may straddle refills and memory stays bounded by the window
+// plus the longest single token.
 class Lexer {
 private:
-    std::string input;
+    std::string input; // the whole source, or the current window
     size_t pos;
-    int line;
-    int column;
-    std::map<std::string, TokenType> keywords;
+    size_t base; // offset of input within the whole source
+    const std::map<std::string, TokenType>& keywords;
     
-    void initKeywords();
+    std::istream* stream; // null unless streaming
+    size_t windowSize;
+    bool streamDone;
+    char lastRead;        // last byte read, to end the stream with '\n'
+    size_t keep;          // start of the token being lexed, kept by refill
+    
+    // Line of the text before lineCursor, for locate
+    size_t lineCursor;
+    size_t lineStart;
+    int lineNumber;
+    
+    bool available(size_t count) { return pos + count <= input.size() || refill(count); }
+    bool refill(size_t count);
+    void trackLines(size_t offset);
+    
+    // Built once per process and shared by every Lexer
+    static std::map<std::string, TokenType> initKeywords();
+    static const std::map<std::string, TokenType>& keywordTable();
     char peek(int offset = 0);
     char advance();
     void skipWhitespace();
@@ -24,8 +48,21 @@ private:
     Token readString();
     
 public:
-    Lexer(const std::string& text);
+    static const size_t DEFAULT_WINDOW = 64 * 1024;
+    
+    Lexer(const std::string& text, size_t baseOffset = 0);
+    // Streams the source; like readSourceFile, a missing final '\n' is added
+    // and a source past MAX_SOURCE_BYTES throws ResourceLimitError
+    explicit Lexer(std::istream& in, size_t windowBytes = DEFAULT_WINDOW);
     Token nextToken();
+    
+    // 1-based line and column of an offset; offsets must not decrease
+    // between calls and must not lie before the last token returned
+    void locate(size_t offset, int& line, int& column);
 };
 
+// Throws ResourceLimitError if a source of this many bytes would have
+// offsets past MAX_SOURCE_BYTES
+void checkSourceSize(size_t bytes);
+
 #endif // LEXER_H
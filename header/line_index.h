@@ -0,0 +1,22 @@
+#ifndef LINE_INDEX_H
+#define LINE_INDEX_H
+
+#include <string>
+#include <vector>
+
+// Offsets of every line start in a source buffer, built once so that token
+// offsets can be turned into line/column positions only when a diagnostic
+// actually needs them.
+class LineIndex {
+private:
+    std::vector<size_t> lineStarts;
+
+public:
+    explicit LineIndex(const std::string& text);
+    
+    int line(size_t offset) const;   // 1-based
+    int column(size_t offset) const; // 1-based, one column per byte
+    size_t lineCount() const { return lineStarts.size(); }
+};
+
+#endif // LINE_INDEX_H
@@ -0,0 +1,71 @@
+#ifndef MEMORY_PROFILER_H
+#define MEMORY_PROFILER_H
+
+#include <cstddef>
+#include <iostream>
+#include "node_kind.h"
+
+class ASTNode;
+
+// Accounts AST memory by node kind while active on a thread (see
+// MemoryProfiler::Scope). ASTNode allocation, addChild and the interner
+// report to it; with no profiler active each hook is one thread-local
+// load. Bytes cover node slots, strings too long for the inline buffer and
+// child-vector capacity. Arena slots of interned duplicates are reclaimed
+// only at reset, and are not counted once the duplicate is dropped.
+//
+// With a sample rate of n, only about one node in n is tracked, chosen by
+// address, and every figure is scaled by n.
+class MemoryProfiler {
+public:
+    struct KindStats {
+        size_t nodes;
+        size_t nodeBytes;   // slots plus heap strings
+        size_t children;    // child pointers held
+        size_t vectorBytes; // child-vector capacity
+        size_t liveBytes;   // nodeBytes + vectorBytes right now
+        size_t peakBytes;   // highest liveBytes seen
+    };
+
+    explicit MemoryProfiler(unsigned sampleRate = 1);
+
+    // Hooks
+    static void noteNew(void* node);
+    static void noteDelete(void* node);
+    static void noteChild(const ASTNode* parent, size_t oldCapacity);
+    static void noteDiscard(const ASTNode* node);
+
+    // Figures so far, scaled by the sample rate
+    KindStats kind(NodeKind k) const;
+    size_t peakBytes() const { return peak * rate; }
+    unsigned sampleRate() const { return rate; }
+
+    void report(std::ostream& out);
+
+    static MemoryProfiler* active();
+
+    // Makes a profiler active for the current thread until destroyed
+    class Scope {
+    public:
+        explicit Scope(MemoryProfiler& profiler);
+        ~Scope();
+    private:
+        MemoryProfiler* previous;
+    };
+
+private:
+    unsigned rate;
+    KindStats stats[NK_KIND_COUNT];
+    size_t live, peak;  // over all kinds
+    void* pending;      // allocated, constructed by the time of the next hook
+
+    bool sampled(const void* node) const;
+    void settle();
+    void grow(NodeKind k, long bytes);
+    static size_t nodeBytes(const ASTNode* node);
+
+    MemoryProfiler(const MemoryProfiler&);
+    MemoryProfiler& operator=(const MemoryProfiler&);
+};
+
+#endif // MEMORY_PROFILER_H
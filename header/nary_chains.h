@@ -0,0 +1,29 @@
+#ifndef NARY_CHAINS_H
+#define NARY_CHAINS_H
+
+#include <cstddef>
+#include "ast_node.h"
+
+// The n-ary form of expression trees. The canonical tree is binary and
+// left-deep, so a + b + c + d is +(+(+(a, b), c), d) and a chain of n
+// operands is n - 1 levels deep. In n-ary form a chain of one associative
+// operator (+, *, and, or) is a single node with one child per operand:
+// +(a, b, c, d). Only the left spine joins a chain; a + (b + c) stays
+// +(a, +(b, c)), so expanding an n-ary node left to right always restores
+// the canonical tree exactly.
+
+// True for the operators that chain: +, *, and, or
+inline bool isAssociative(NodeKind kind) {
+    return kind == NK_PLUS || kind == NK_MUL || kind == NK_AND || kind == NK_OR;
+}
+
+// Rewrites every left-deep chain below root as one n-ary node, in place.
+// Returns the number of binary nodes folded away.
+size_t flattenChains(ASTNode* root);
+
+// Rewrites every n-ary node below root as the canonical left-deep binary
+// chain, in place, allocating the inner levels from the active arena.
+// Returns the number of nodes added.
+size_t expandChains(ASTNode* root);
+
+#endif // NARY_CHAINS_H
@@ -0,0 +1,57 @@
+#ifndef NODE_ARENA_H
+#define NODE_ARENA_H
+
+#include <cstddef>
+#include <vector>
+#include "parse_limits.h"
+
+class ASTNode;
+
+// Bump allocator for ASTNode objects. While an arena is active on a thread
+// (see NodeArena::Scope), every `new ASTNode` on that thread is carved from
+// its blocks. reset() destroys all nodes at once and keeps the blocks, so a
+// long-running process parses each request into already-warm memory.
+// Nodes allocated from an arena must not be deleted individually.
+class NodeArena {
+public:
+    explicit NodeArena(size_t nodesPerBlock = 1024);
+    ~NodeArena();
+
+    void* allocate(size_t bytes);
+    bool releaseLast(void* p); // undo allocate() when a constructor throws
+    bool isLast(const void* p) const;
+    void reset();
+
+    // Makes allocate() throw ResourceLimitError past limits.maxNodes live
+    // nodes or once a new block would exceed limits.maxArenaBytes
+    void setLimits(const ParseLimits& limits);
+
+    size_t nodeCount() const { return count; }
+    size_t bytesReserved() const { return blocks.size() * blockBytes; }
+    size_t bytesUsed() const { return count * slotBytes; }
+
+    static NodeArena* active();
+
+    // Makes an arena active for the current thread until destroyed
+    class Scope {
+    public:
+        explicit Scope(NodeArena& arena);
+        ~Scope();
+    private:
+        NodeArena* previous;
+    };
+
+private:
+    std::vector<char*> blocks;
+    size_t slotBytes;
+    size_t blockBytes;
+    size_t slotsPerBlock;
+    size_t count; // slots handed out since the last reset
+    size_t maxNodes;
+    size_t maxBytes;
+
+    NodeArena(const NodeArena&);
+    NodeArena& operator=(const NodeArena&);
+};
+
+#endif // NODE_ARENA_H
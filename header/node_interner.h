@@ -0,0 +1,56 @@
+#ifndef NODE_INTERNER_H
+#define NODE_INTERNER_H
+
+#include <cstddef>
+#include <vector>
+#include "ast_node.h"
+
+// Hash-consing table for AST construction. While an interner is active on
+// a thread (see NodeInterner::Scope), ASTNode::addChild interns each child
+// as it is attached: a child that is structurally identical to one seen
+// before is replaced by that node and the copy freed, so the finished tree
+// is a DAG in which every shared subtree exists once. Children are always
+// interned before their parent, so two nodes are equal exactly when their
+// types and values match and their child pointers are identical.
+// Interned nodes are shared and must not be modified.
+class NodeInterner {
+public:
+    NodeInterner();
+    ~NodeInterner();
+
+    // Returns the canonical node for node, which must be complete
+    ASTNode* intern(ASTNode* node);
+
+    size_t internedCount() const { return interned; } // nodes passed to intern()
+    size_t uniqueCount() const { return unique; }     // distinct nodes kept
+
+    static NodeInterner* active();
+    // intern() with the thread's active interner, if any
+    static ASTNode* share(ASTNode* node);
+
+    // Makes an interner active for the current thread until destroyed
+    class Scope {
+    public:
+        explicit Scope(NodeInterner& interner);
+        ~Scope();
+    private:
+        NodeInterner* previous;
+    };
+
+private:
+    std::vector<ASTNode*> slots; // open addressing, power-of-two size
+    size_t interned;
+    size_t unique;
+
+    void grow();
+
+    NodeInterner(const NodeInterner&);
+    NodeInterner& operator=(const NodeInterner&);
+};
+
+// Structural equality of two subtrees. Nodes interned by the same
+// NodeInterner compare in O(1) by pointer and hash; otherwise the trees are
+// walked.
+bool sameSubtree(const ASTNode* a, const ASTNode* b);
+
+#endif // NODE_INTERNER_H
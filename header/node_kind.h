@@ -0,0 +1,43 @@
+#ifndef NODE_KIND_H
+#define NODE_KIND_H
+
+#include <string>
+
+// Integer tag for every node type the parser produces, so passes can
+// switch on it instead of comparing nodeType strings. NK_TEXT marks the
+// childless text nodes under <identifier>, <integer>, <char> and <string>,
+// whose nodeType is source text and may spell a node type name.
+enum NodeKind {
+    NK_UNKNOWN,
+    NK_TEXT,
+    // Declarations
+    NK_PROGRAM, NK_CONSTS, NK_CONST, NK_TYPES, NK_TYPE, NK_LIT, NK_DCLNS, NK_VAR,
+    NK_SUBPROGS, NK_FCN, NK_PARAMS,
+    // Statements
+    NK_BLOCK, NK_ASSIGN, NK_SWAP, NK_OUTPUT, NK_IF, NK_WHILE, NK_REPEAT, NK_FOR, NK_LOOP,
+    NK_CASE, NK_CASE_CLAUSE, NK_RANGE, NK_OTHERWISE, NK_READ, NK_EXIT, NK_RETURN, NK_NULL,
+    NK_OUTPUT_INTEGER, NK_OUTPUT_STRING,
+    // Literals
+    NK_IDENTIFIER, NK_INTEGER, NK_CHAR, NK_STRING, NK_TRUE,
+    // Expressions; NK_MINUS is unary with one child
+    NK_LE, NK_LT, NK_GE, NK_GT, NK_EQ, NK_NE, NK_PLUS, NK_MINUS, NK_OR,
+    NK_MUL, NK_DIV, NK_AND, NK_MOD, NK_NOT, NK_SUCC, NK_PRED, NK_CHR, NK_ORD, NK_EOF, NK_CALL,
+    NK_KIND_COUNT
+};
+
+// Kind of a node type name; NK_UNKNOWN for anything else
+NodeKind classifyNodeType(const std::string& type);
+// The node type name of a kind, "text" or "unknown"
+const char* nodeKindName(NodeKind kind);
+
+enum NodeCategory { CAT_DECLARATION, CAT_STATEMENT, CAT_LITERAL, CAT_EXPRESSION, CAT_OTHER };
+
+inline NodeCategory nodeCategory(NodeKind kind) {
+    if (kind >= NK_PROGRAM && kind <= NK_PARAMS) return CAT_DECLARATION;
+    if (kind >= NK_BLOCK && kind <= NK_OUTPUT_STRING) return CAT_STATEMENT;
+    if (kind >= NK_IDENTIFIER && kind <= NK_TRUE) return CAT_LITERAL;
+    if (kind >= NK_LE && kind <= NK_CALL) return CAT_EXPRESSION;
+    return CAT_OTHER;
+}
+
+#endif // NODE_KIND_H
@@ -0,0 +1,41 @@
+#ifndef PARALLEL_LEXER_H
+#define PARALLEL_LEXER_H
+
+#include <string>
+#include <vector>
+#include "token.h"
+
+// Lexes one source buffer on several threads. The buffer is split at
+// newline boundaries; a multi-state pre-pass finds, for every chunk and every
+// state the previous chunk could end in (plain code, inside a { } comment,
+// inside a string, just after a char literal body), where the chunk first
+// returns to plain code at a line start. Chunks are then re-cut at those
+// points, lexed independently with their base offset and concatenated,
+// producing exactly the token stream of the sequential Lexer.
+class ParallelLexer {
+public:
+    // Chunks smaller than this are not worth a thread of their own
+    static const size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+    ParallelLexer(const std::string& text, unsigned threadCount);
+    std::vector<Token> tokenize();
+
+private:
+    enum { ENTRY_STATES = 4 };
+
+    struct ChunkSummary {
+        size_t begin;
+        size_t end;
+        int exitState[ENTRY_STATES];
+        size_t syncPos[ENTRY_STATES]; // first plain-code line start after begin
+    };
+
+    const std::string& input;
+    unsigned threads;
+
+    void summarize(ChunkSummary& chunk) const;
+    static void lexRange(const std::string& text, size_t baseOffset, bool keepEof,
+                         std::vector<Token>& tokens);
+};
+
+#endif // PARALLEL_LEXER_H
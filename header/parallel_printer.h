@@ -0,0 +1,14 @@
+#ifndef PARALLEL_PRINTER_H
+#define PARALLEL_PRINTER_H
+
+#include "ast_node.h"
+
+// Writes exactly what root->print(0) would to the file descriptor, using up
+// to threads workers. The tree is cut into independent pieces: the lines of
+// nodes too large to render as one unit, and runs of consecutive sibling
+// subtrees small enough to be one. Each worker renders its pieces at their
+// known depth into its own buffer, and the pieces go out in tree order
+// with writev. Throws if the write fails.
+void printTreeParallel(const ASTNode* root, int fd, unsigned threads);
+
+#endif // PARALLEL_PRINTER_H
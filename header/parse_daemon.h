@@ -0,0 +1,59 @@
+#ifndef PARSE_DAEMON_H
+#define PARSE_DAEMON_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <sstream>
+#include <vector>
+#include "parse_limits.h"
+
+class NodeArena;
+
+// Wire protocol (one or more requests per connection):
+//   PARSE <path>\n            parse a file readable by the daemon
+//   SOURCE <bytes>\n<source>  parse inline source text
+//   STATS\n                   request count and p50/p99 latency
+// Every response is "OK <bytes>\n<payload>" or "ERR <bytes>\n<message>",
+// where an OK payload for a parse is exactly what -ast prints.
+
+// Long-running parser serving requests on a Unix domain socket. A fixed
+// pool of workers handles connections; each keeps its own NodeArena and
+// output buffer warm across requests. A request that exceeds the parse
+// limits gets an ERR response without affecting other requests.
+class ParseDaemon {
+public:
+    ParseDaemon(const std::string& socketPath, unsigned workerCount,
+                const ParseLimits& parseLimits = ParseLimits());
+    int run();
+
+private:
+    std::string path;
+    unsigned workers;
+    ParseLimits limits;
+
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<int> pending;
+    std::set<int> active; // connections being served, shut down on stop
+    bool stopping;
+
+    std::mutex statsMutex;
+    std::vector<double> latencies; // most recent request latencies in ms
+    size_t latencyNext;
+    unsigned long long requests;
+
+    void workerLoop();
+    void serveConnection(int fd, NodeArena& arena, std::ostringstream& output);
+    void recordLatency(double ms);
+    std::string statsReport();
+};
+
+// Sends one request to a daemon and copies the payload to stdout. Returns
+// the process exit status.
+int runParseClient(const std::string& socketPath, const std::string& request,
+                   const std::string& payload);
+
+#endif // PARSE_DAEMON_H
@@ -0,0 +1,28 @@
+#ifndef PARSE_LIMITS_H
+#define PARSE_LIMITS_H
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+// Budgets for one parse. A value of 0 disables that budget. The depth
+// budget is enforced by the Parser and also bounds the depth of the tree,
+// so the recursive printers and walkers downstream stay within the stack.
+// Node and byte budgets are enforced by the NodeArena the tree is built in.
+struct ParseLimits {
+    static const size_t DEFAULT_MAX_DEPTH = 2000;
+
+    size_t maxDepth;      // nested statements, expressions and operator chains
+    size_t maxNodes;      // nodes allocated from the arena
+    size_t maxArenaBytes; // arena blocks reserved
+
+    ParseLimits() : maxDepth(DEFAULT_MAX_DEPTH), maxNodes(0), maxArenaBytes(0) {}
+};
+
+// Thrown when a parse exceeds one of its ParseLimits
+class ResourceLimitError : public std::runtime_error {
+public:
+    explicit ResourceLimitError(const std::string& what) : std::runtime_error(what) {}
+};
+
+#endif // PARSE_LIMITS_H
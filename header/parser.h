@@ -2,15 +2,32 @@
 #define PARSER_H
 
 #include <string>
+#include <vector>
 #include "token.h"
 #include "lexer.h"
 #include "ast_node.h"
+#include "parse_limits.h"
+
+class TokenRing;
+class LazyBodies;
 
 class Parser {
 private:
     Lexer lexer;
     Token currentToken;
+    std::vector<Token> tokens; // pre-lexed input or current ring batch
+    size_t tokenIndex;
+    bool buffered;             // read from tokens/ring instead of lexer
+    TokenRing* ring;           // batches from a lexer thread, null once drained
+    ParseLimits limits;
+    size_t depth;              // parse functions currently nested
+    LazyBodies* lazyBodies;    // where skipped function bodies go, if deferred
+    bool flatChains;           // build + * and or chains as one n-ary node
+    bool finished;             // parseProgram read the final '.' and then EOF
     
+    struct Nesting;
+    void checkDepth(size_t extra);
+    Token nextToken();
     void advance();
     bool match(TokenType type);
     bool consume(TokenType type);
@@ -19,9 +36,27 @@ private:
     ASTNode* createIntegerNode(const std::string& value);
     ASTNode* createCharNode(const std::string& value);
     ASTNode* createStringNode(const std::string& value);
+    ASTNode* skipBody();
 
 public:
-    Parser(const std::string& input);
+    Parser(const std::string& input, size_t baseOffset = 0);
+    Parser(std::istream& in); // lexes through a bounded window
+    Parser(const std::vector<Token>& lexed);
+    Parser(TokenRing& source);
+    
+    // Only maxDepth applies here; node and byte budgets belong to the arena
+    void setLimits(const ParseLimits& parseLimits) { limits = parseLimits; }
+    
+    // Leave function bodies unparsed, recording them in bodies instead
+    void deferBodies(LazyBodies* bodies) { lazyBodies = bodies; }
+    
+    // Give a chain like a + b + c one node with an operand per child for
+    // +, *, and, or (see expandChains)
+    void setFlattenChains(bool flatten) { flatChains = flatten; }
+    
+    // Whether the last parseProgram ended with '.' followed by end of input;
+    // a truncated program still yields a tree, but not a complete one
+    bool complete() const { return finished; }
     
     // Forward declarations for parsing functions
     ASTNode* parseProgram();
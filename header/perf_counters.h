@@ -0,0 +1,45 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <chrono>
+#include <string>
+
+// Hardware counters for the calling thread, read through perf_event_open
+// as one group so they cover exactly the same instructions. Counters the
+// kernel or CPU refuses are left out; wall time is always measured.
+class PerfCounters {
+public:
+    enum Counter { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, COUNTER_COUNT };
+
+    struct Sample {
+        double wallNs;
+        uint64_t values[COUNTER_COUNT];
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    bool available(Counter counter) const { return fds[counter] >= 0; }
+    bool anyAvailable() const { return leader >= 0; }
+    // Why the first counter could not be opened, if none could
+    const std::string& unavailableReason() const { return reason; }
+
+    void start();
+    Sample stop();
+
+    static const char* name(Counter counter);
+
+private:
+    int fds[COUNTER_COUNT];
+    int order[COUNTER_COUNT]; // group read position of each counter
+    int opened;
+    int leader;
+    std::string reason;
+    std::chrono::steady_clock::time_point started;
+
+    PerfCounters(const PerfCounters&);
+    PerfCounters& operator=(const PerfCounters&);
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,16 @@
+#ifndef SOURCE_FILES_H
+#define SOURCE_FILES_H
+
+#include <string>
+#include <vector>
+
+// Reads a source file the way winzigc always has: line by line, with every
+// line (including the last) terminated by '\n'. Throws ResourceLimitError
+// once the source passes MAX_SOURCE_BYTES.
+bool readSourceFile(const std::string& filename, std::string& input);
+
+// Every file under dir and its subdirectories, except .tree goldens and
+// dot files, sorted
+std::vector<std::string> findSourceFiles(const std::string& dir);
+
+#endif // SOURCE_FILES_H
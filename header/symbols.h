@@ -0,0 +1,79 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include "ast_node.h"
+
+enum SymbolKind {
+    SYM_VAR,      // variable or parameter, stored in a slot
+    SYM_CONST,    // named constant from a 'const' section
+    SYM_LITERAL,  // enumeration literal from a 'type' section
+    SYM_FUNCTION
+};
+
+struct Symbol {
+    SymbolKind kind;
+    std::string typeName; // declared type ("integer", "char", "boolean" or an enum name)
+    int value;            // constant/literal value
+    int slot;             // variable slot within its scope
+
+    Symbol(SymbolKind k = SYM_VAR, const std::string& t = "integer", int v = 0, int s = -1)
+        : kind(k), typeName(t), value(v), slot(s) {}
+};
+
+struct Scope {
+    std::map<std::string, Symbol> symbols;
+    std::vector<std::string> vars;      // variable names in slot order
+    std::vector<std::string> constants; // const and literal names in declaration order
+
+    const Symbol* find(const std::string& name) const;
+};
+
+struct FunctionInfo {
+    std::string name;
+    const ASTNode* node;
+    std::vector<std::string> params;
+    Scope locals;
+};
+
+// Name resolution for a parsed program. WinZig has one global scope plus one
+// flat scope per function, and variables that are assigned without being
+// declared (the 'd := Call(...)' idiom) become implicit global integers.
+class ProgramInfo {
+public:
+    std::string name;
+    Scope globals;
+    std::vector<FunctionInfo> functions;
+    std::vector<std::string> implicitGlobals;
+
+    explicit ProgramInfo(const ASTNode* program);
+
+    const FunctionInfo* findFunction(const std::string& name) const;
+    const Symbol* lookup(const FunctionInfo* fn, const std::string& name) const;
+
+private:
+    std::map<std::string, size_t> functionIndex;
+
+    void declareConsts(const ASTNode* consts, Scope& scope);
+    void declareTypes(const ASTNode* types, Scope& scope);
+    void declareVars(const ASTNode* dclns, Scope& scope, std::vector<std::string>* names);
+    void collectImplicit(const ASTNode* node, const FunctionInfo* fn);
+};
+
+// Text of a leaf wrapper such as <identifier>(1) -> name(0).
+std::string leafText(const ASTNode* node);
+
+// Value of an integer literal, wrapped to 32 bits.
+int integerValue(const std::string& text);
+
+// Value of a char literal such as 'a'.
+int charValue(const std::string& text);
+
+// One line per function, e.g. Max(a, b: integer; c: char): integer. Reads
+// only names, params and return types, so bodies may still be unparsed.
+void printSignatures(const ASTNode* program, std::ostream& out);
+
+#endif // SYMBOLS_H
@@ -0,0 +1,49 @@
+#ifndef TABLE_PARSER_H
+#define TABLE_PARSER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "token.h"
+#include "lexer.h"
+#include "ast_node.h"
+#include "parse_limits.h"
+
+// Table-driven LL(1) parser over the grammar in winzig_grammar.h. It builds
+// the same trees as Parser, but from an explicit symbol stack and a predict
+// table indexed by nonterminal and token, so no C++ recursion grows with
+// the input. Unlike Parser it throws on a syntax error, naming the byte
+// offset of the unexpected token.
+class TableParser {
+private:
+    Lexer lexer;
+    Token currentToken;
+    Token lastToken;             // the token the latest leaf action reads
+    std::vector<Token> tokens;   // pre-lexed input
+    size_t tokenIndex;
+    bool buffered;
+    ParseLimits limits;
+    size_t depth;                // statements and primaries currently open
+    std::vector<uint16_t> symbols;
+    std::vector<ASTNode*> nodes;
+    std::vector<size_t> marks;   // node stack heights for variable-arity builds
+    std::vector<size_t> chains;  // operators in each open expression level
+
+    void checkDepth(size_t extra);
+    void advance();
+    void expand(unsigned nonTerminal);
+    void act(unsigned action);
+    [[noreturn]] void syntaxError();
+
+public:
+    TableParser(const std::string& input);
+    TableParser(std::istream& in);
+    TableParser(const std::vector<Token>& lexed);
+
+    // Only maxDepth applies here, as for Parser
+    void setLimits(const ParseLimits& parseLimits) { limits = parseLimits; }
+
+    ASTNode* parseProgram();
+};
+
+#endif // TABLE_PARSER_H
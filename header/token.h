@@ -1,6 +1,7 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <cstddef>
 #include <string>
 
 enum TokenType {
@@ -28,14 +29,18 @@ enum TokenType {
     TOK_EOF, TOK_NEWLINE, TOK_UNKNOWN
 };
 
+// Tokens record only their starting byte offset; line and column are
+// resolved on demand through a LineIndex. A 32-bit offset keeps the token
+// compact and limits a single source to 4 GB (see checkSourceSize).
+const size_t MAX_SOURCE_BYTES = 0xffffffffu;
+
 struct Token {
     TokenType type;
+    unsigned int offset;
     std::string value;
-    int line;
-    int column;
     
-    Token(TokenType t = TOK_UNKNOWN, const std::string& v = "", int l = 1, int c = 1)
-        : type(t), value(v), line(l), column(c) {}
+    Token(TokenType t = TOK_UNKNOWN, const std::string& v = "", size_t off = 0)
+        : type(t), offset((unsigned int)off), value(v) {}
 };
 
 #endif // TOKEN_H
@@ -0,0 +1,51 @@
+#ifndef TOKEN_RING_H
+#define TOKEN_RING_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include "token.h"
+#include "ast_node.h"
+#include "parse_limits.h"
+
+// Lock-free single-producer/single-consumer ring of token batches. Batches
+// are exchanged by swapping vectors, so their storage is recycled between
+// the lexer and parser threads. The producer and consumer indices live on
+// separate cache lines to avoid false sharing.
+class TokenRing {
+public:
+    static const size_t CAPACITY = 64;     // batches, power of two
+    static const size_t BATCH_TOKENS = 512;
+
+    TokenRing();
+
+    // Blocks while the ring is full; returns false once the consumer closed it
+    bool push(std::vector<Token>& batch);
+    // Blocks while the ring is empty
+    void pop(std::vector<Token>& batch);
+    // Called by the consumer when it stops reading early
+    void close();
+
+private:
+    alignas(64) std::atomic<size_t> head; // next batch to pop
+    alignas(64) std::atomic<size_t> tail; // next batch to push
+    alignas(64) std::atomic<bool> closed;
+    std::vector<Token> slots[CAPACITY];
+};
+
+// Parses a source with the lexer running on its own thread and feeding the
+// parser through a TokenRing. Inputs below MIN_PIPELINE_BYTES are parsed
+// serially, where thread startup would cost more than the overlap saves.
+class PipelinedParse {
+public:
+    static const size_t MIN_PIPELINE_BYTES = 64 * 1024;
+
+    explicit PipelinedParse(const std::string& text, const ParseLimits& parseLimits = ParseLimits());
+    ASTNode* parseProgram();
+
+private:
+    const std::string& input;
+    ParseLimits limits;
+};
+
+#endif // TOKEN_RING_H
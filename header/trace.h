@@ -0,0 +1,62 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <string>
+
+// Timeline of what each thread did, written as Chrome trace-event JSON for
+// Perfetto or chrome://tracing. Nothing is recorded until enable(); a span
+// on a disabled tracer costs one load. Every thread appends to a buffer of
+// its own, so recording takes no lock; the buffer is registered once,
+// under a mutex, on the thread's first span.
+class Tracer {
+public:
+    static void enable();
+    static bool enabled() { return on; }
+
+    // Labels the calling thread's track
+    static void nameThread(const std::string& name);
+
+    // Writes every span recorded so far. Threads that record must have
+    // finished. Returns false if the file cannot be written.
+    static bool write(const std::string& path);
+
+    // Tags the spans the current thread starts with a file until destroyed
+    class FileScope {
+    public:
+        explicit FileScope(const std::string& file);
+        ~FileScope();
+    private:
+        int previous;
+    };
+
+private:
+    static bool on;
+};
+
+// Records the time from construction to destruction as one complete event.
+// name and category must outlive the tracer, so they are string literals.
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* category = "winzigc") : index(-1) {
+        if (Tracer::enabled()) begin(name, category);
+    }
+    ~TraceSpan() {
+        if (index >= 0) end();
+    }
+
+    bool active() const { return index >= 0; }
+    // Shown as args.name, e.g. the function a parseFcn span covers
+    void setDetail(const std::string& detail);
+
+private:
+    long index; // into the thread's buffer, -1 when not recording
+
+    void begin(const char* name, const char* category);
+    void end();
+
+    TraceSpan(const TraceSpan&);
+    TraceSpan& operator=(const TraceSpan&);
+};
+
+#endif // TRACE_H
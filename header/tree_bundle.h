@@ -0,0 +1,72 @@
+#ifndef TREE_BUNDLE_H
+#define TREE_BUNDLE_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// One archive holding the rendered trees of many inputs, in place of a
+// tree file per input. All integers are little-endian:
+//
+//   "WZBUNDL1"  u64 format (0 = -ast text, 1 = -json)
+//   tree bytes of every input, back to back
+//   index:  count entries of 40 bytes
+//             u64 offset, u64 length, u64 hash, u64 path offset, u32 path length, u32 0
+//           tableSize u32 slots, each 0 or entry number + 1, probed
+//           linearly from the path hash
+//           the paths, back to back
+//   "WZBIDX01"  u64 index offset, u64 count, u64 tableSize
+//
+// Offsets are from the start of the file, except path offsets, which are
+// from the start of the paths. Hashes are 64-bit FNV-1a, of the tree bytes
+// for an entry and of the path for its slot.
+enum BundleFormat { BUNDLE_TEXT, BUNDLE_JSON };
+
+uint64_t bundleHash(const char* data, size_t size);
+
+// Parses and renders files on up to threads workers and writes them to
+// archive in input order. Files that fail are reported and left out.
+// Returns the number of files bundled; throws if the archive cannot be
+// written.
+size_t writeBundle(const std::vector<std::string>& files, const std::string& archive, BundleFormat format,
+                   unsigned threads, std::ostream& report);
+
+// Read-only view of an archive through mmap. Lookups hash the path and
+// probe the slot table, so fetching one tree touches a few pages no matter
+// how large the archive is.
+class BundleReader {
+public:
+    struct Entry {
+        std::string path;
+        const char* data;
+        size_t length;
+        uint64_t hash;
+    };
+
+    explicit BundleReader(const std::string& archive); // throws if malformed
+    ~BundleReader();
+
+    BundleFormat format() const { return kind; }
+    size_t size() const { return count; }
+    Entry entry(size_t i) const;
+
+    // False if the archive has no tree for path
+    bool find(const std::string& path, Entry& result) const;
+
+private:
+    const char* base;
+    size_t mapped;
+    BundleFormat kind;
+    size_t count, tableSize;
+    const char* entries;
+    const char* slots;
+    const char* paths;
+    size_t pathBytes;
+
+    BundleReader(const BundleReader&);
+    BundleReader& operator=(const BundleReader&);
+};
+
+#endif // TREE_BUNDLE_H
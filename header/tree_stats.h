@@ -0,0 +1,34 @@
+#ifndef TREE_STATS_H
+#define TREE_STATS_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ast_node.h"
+
+struct FunctionStats {
+    std::string name;
+    size_t nodes;
+    int depth; // deepest node, counted from the program root
+    size_t statements;
+    size_t calls;
+};
+
+struct TreeStats {
+    size_t nodes;
+    int depth;
+    size_t kinds[NK_KIND_COUNT];
+    size_t categories[CAT_OTHER + 1];
+    std::vector<FunctionStats> functions;
+};
+
+// Node, kind and category counts for a program, built on AstVisitor. The
+// functions under subprogs are counted on up to threads workers and merged.
+TreeStats collectTreeStats(const ASTNode* program, unsigned threads);
+void printTreeStats(const TreeStats& stats, std::ostream& out);
+
+// The same category counts found by comparing nodeType strings, the way
+// passes dispatched before NodeKind; -stats -time reports both timings
+void countCategoriesByName(const ASTNode* root, size_t categories[CAT_OTHER + 1]);
+
+#endif // TREE_STATS_H
@@ -0,0 +1,97 @@
+#ifndef WINZIG_H
+#define WINZIG_H
+
+/* C interface of libwinzig, for parsing in-process without running winzigc.
+ *
+ *   winzig_tree* tree;
+ *   if (winzig_parse(source, length, NULL, &tree) == WINZIG_OK) {
+ *       size_t needed;
+ *       winzig_render(winzig_root(tree), WINZIG_FORMAT_AST, buffer, sizeof(buffer), &needed);
+ *   } else {
+ *       fprintf(stderr, "%s\n", winzig_error(tree));
+ *   }
+ *   winzig_free(tree);
+ *
+ * Every tree owns its nodes in one arena, and winzig_free releases all of
+ * them at once. Node handles stay valid until their tree is freed.
+ * Concurrent calls are safe for different trees. A single tree may be read
+ * from several threads, but must not be freed while another thread uses it.
+ * No function throws or writes to stdout or stderr. */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define WINZIG_API __attribute__((visibility("default")))
+#else
+#define WINZIG_API
+#endif
+
+/* Bumped on any incompatible change to this header */
+#define WINZIG_API_VERSION 1
+
+typedef struct winzig_tree winzig_tree;
+typedef struct winzig_node winzig_node;
+
+typedef enum {
+    WINZIG_OK = 0,
+    WINZIG_ERR_SYNTAX = 1,   /* the source is not a complete WinZig program */
+    WINZIG_ERR_LIMIT = 2,    /* a winzig_limits budget was exceeded, or the
+                                source is over 4 GB */
+    WINZIG_ERR_MEMORY = 3,
+    WINZIG_ERR_ARGUMENT = 4,
+    WINZIG_ERR_TRUNCATED = 5 /* the render buffer was too small */
+} winzig_status;
+
+typedef enum {
+    WINZIG_FORMAT_AST = 0,  /* exactly what winzigc -ast prints */
+    WINZIG_FORMAT_JSON = 1  /* exactly what winzigc -json prints */
+} winzig_format;
+
+/* Zero disables a budget; see winzig_default_limits */
+typedef struct {
+    size_t max_depth;
+    size_t max_nodes;
+    size_t max_arena_bytes;
+} winzig_limits;
+
+WINZIG_API int winzig_api_version(void);
+WINZIG_API void winzig_default_limits(winzig_limits* limits);
+
+/* Parses length bytes of source; limits may be NULL for the defaults. A
+ * program that stops before its final '.', or has more after it, is
+ * WINZIG_ERR_SYNTAX. On success *tree holds the program. On failure
+ * *tree, if not NULL, holds only the message for winzig_error. Either
+ * way it must be freed. */
+WINZIG_API winzig_status winzig_parse(const char* source, size_t length, const winzig_limits* limits,
+                                      winzig_tree** tree);
+WINZIG_API void winzig_free(winzig_tree* tree);
+
+/* Empty string after a successful parse */
+WINZIG_API const char* winzig_error(const winzig_tree* tree);
+/* NULL if the parse failed */
+WINZIG_API const winzig_node* winzig_root(const winzig_tree* tree);
+WINZIG_API size_t winzig_node_count(const winzig_tree* tree);
+
+/* The node's type as printed by -ast: "program", "assign", "<identifier>",
+ * or for the text leaves under literals, the text itself */
+WINZIG_API const char* winzig_node_type(const winzig_node* node);
+WINZIG_API size_t winzig_node_child_count(const winzig_node* node);
+/* NULL if index is out of range */
+WINZIG_API const winzig_node* winzig_node_child(const winzig_node* node, size_t index);
+
+/* Renders the subtree at node into buffer like snprintf: at most
+ * capacity - 1 bytes and a terminating NUL. *needed (if not NULL) receives
+ * the full length without the NUL, so a call with capacity 0 sizes the
+ * buffer. Returns WINZIG_ERR_TRUNCATED if the text did not fit. */
+WINZIG_API winzig_status winzig_render(const winzig_node* node, winzig_format format, char* buffer,
+                                       size_t capacity, size_t* needed);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WINZIG_H */
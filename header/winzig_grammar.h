@@ -0,0 +1,440 @@
+#ifndef WINZIG_GRAMMAR_H
+#define WINZIG_GRAMMAR_H
+
+#include <stdint.h>
+#include "token.h"
+
+// The WinZig grammar as data, for the table-driven TableParser. Right-hand
+// sides mix tokens, nonterminals and tree-building actions; the nullable,
+// FIRST and FOLLOW sets and the LL(1) predict table below are all computed
+// by the compiler. The productions reproduce the trees of the hand-written
+// Parser, including where its loops stop, and a static_assert rejects the
+// grammar if any table cell is ambiguous.
+
+enum NonTerminal {
+    NT_PROGRAM, NT_NAME, NT_NAME_MORE,
+    NT_CONSTS, NT_CONST_LIST, NT_CONST_MORE, NT_CONST, NT_CONST_VALUE,
+    NT_TYPES, NT_TYPE_LIST, NT_TYPE_MORE, NT_TYPE, NT_LIT,
+    NT_DCLNS, NT_DCLN_LIST, NT_DCLN_MORE, NT_DCLN,
+    NT_SUBPROGS, NT_FCN_LIST, NT_FCN, NT_PARAMS, NT_PARAM_LIST, NT_PARAM_MORE,
+    NT_BLOCK, NT_BLOCK_BODY, NT_STMT_REST, NT_OPT_STMT, NT_STMT, NT_ASSIGN_TAIL,
+    NT_OUT_EXP, NT_OUT_MORE, NT_ELSE_PART, NT_REPEAT_REST, NT_REPEAT_NEXT, NT_LOOP_REST, NT_LOOP_NEXT,
+    NT_FOR_STAT, NT_FOR_EXP, NT_CLAUSES, NT_CLAUSE, NT_CASE_RANGE, NT_CASE_SEMI, NT_OTHERWISE,
+    NT_EXPR, NT_EXPR_TAIL, NT_TERM, NT_TERM_TAIL, NT_FACTOR, NT_FACTOR_TAIL, NT_PRIMARY,
+    NT_CALL_TAIL, NT_ARGS, NT_ARG_MORE,
+    NT_COUNT
+};
+
+// Actions run when the parser pops them. Leaf actions turn the token just
+// matched into a literal node; MARK records the node stack height for the
+// next build of a variable number of children (MARK_LAST includes the
+// node on top); BUILD_* pop their children and push the new node.
+enum Action {
+    ACT_IDENT, ACT_INTEGER, ACT_CHAR, ACT_STRING, ACT_MARK, ACT_MARK_LAST,
+    // Pushed by the parser itself, never written in a production
+    ACT_END_NESTING, ACT_END_CHAIN,
+    BUILD_PROGRAM, BUILD_CONSTS, BUILD_CONST, BUILD_TYPES, BUILD_TYPE, BUILD_LIT, BUILD_DCLNS, BUILD_VAR,
+    BUILD_SUBPROGS, BUILD_FCN, BUILD_PARAMS, BUILD_BLOCK, BUILD_ASSIGN, BUILD_SWAP, BUILD_OUTPUT,
+    BUILD_OUT_STRING, BUILD_OUT_INTEGER, BUILD_IF, BUILD_WHILE, BUILD_REPEAT, BUILD_FOR, BUILD_LOOP,
+    BUILD_CASE, BUILD_CASE_CLAUSE, BUILD_RANGE, BUILD_OTHERWISE, BUILD_READ, BUILD_EXIT, BUILD_RETURN,
+    BUILD_NULL, BUILD_TRUE,
+    BUILD_LE, BUILD_LT, BUILD_GE, BUILD_GT, BUILD_EQ, BUILD_NE, BUILD_PLUS, BUILD_MINUS, BUILD_OR,
+    BUILD_MUL, BUILD_DIV, BUILD_AND, BUILD_MOD,
+    BUILD_NEG, BUILD_NOT, BUILD_SUCC, BUILD_PRED, BUILD_CHR, BUILD_ORD, BUILD_EOF, BUILD_CALL,
+    ACTION_COUNT
+};
+
+namespace grammar {
+
+const unsigned TOKEN_COUNT = TOK_UNKNOWN + 1;
+
+// Symbol 0 ends a right-hand side; tokens are shifted up by one
+typedef uint16_t Symbol;
+const Symbol END_OF_RHS = 0;
+const Symbol NT_BASE = 128;
+const Symbol ACTION_BASE = 256;
+
+constexpr Symbol sym(TokenType t) { return Symbol(t + 1); }
+constexpr Symbol sym(NonTerminal n) { return Symbol(NT_BASE + n); }
+constexpr Symbol sym(Action a) { return Symbol(ACTION_BASE + a); }
+constexpr bool isToken(Symbol s) { return s != END_OF_RHS && s < NT_BASE; }
+constexpr bool isNonTerminal(Symbol s) { return s >= NT_BASE && s < ACTION_BASE; }
+constexpr unsigned tokenOf(Symbol s) { return s - 1u; }
+constexpr unsigned nonTerminalOf(Symbol s) { return s - NT_BASE; }
+constexpr unsigned actionOf(Symbol s) { return s - ACTION_BASE; }
+
+const unsigned MAX_RHS = 16;
+
+struct Production {
+    NonTerminal lhs;
+    bool preferred; // wins a table cell it would otherwise share
+    Symbol rhs[MAX_RHS];
+};
+
+template <class... Symbols>
+constexpr Production rule(NonTerminal lhs, Symbols... rhs) {
+    static_assert(sizeof...(rhs) < MAX_RHS, "right-hand side too long");
+    return Production{lhs, false, {sym(rhs)...}};
+}
+
+template <class... Symbols>
+constexpr Production preferredRule(NonTerminal lhs, Symbols... rhs) {
+    static_assert(sizeof...(rhs) < MAX_RHS, "right-hand side too long");
+    return Production{lhs, true, {sym(rhs)...}};
+}
+
+// Productions of one nonterminal must be listed together
+constexpr Production PRODUCTIONS[] = {
+    rule(NT_PROGRAM, TOK_PROGRAM, NT_NAME, TOK_COLON, NT_CONSTS, NT_TYPES, NT_DCLNS, NT_SUBPROGS, NT_BLOCK,
+         NT_NAME, TOK_DOT, BUILD_PROGRAM),
+
+    rule(NT_NAME, TOK_IDENTIFIER, ACT_IDENT),
+    rule(NT_NAME, TOK_INTEGER_TYPE, ACT_IDENT),
+    rule(NT_NAME, TOK_BOOLEAN, ACT_IDENT),
+    rule(NT_NAME_MORE, TOK_COMMA, NT_NAME, NT_NAME_MORE),
+    rule(NT_NAME_MORE),
+
+    rule(NT_CONSTS, ACT_MARK, NT_CONST_LIST, BUILD_CONSTS),
+    rule(NT_CONST_LIST, TOK_CONST, NT_CONST, NT_CONST_MORE, TOK_SEMICOLON),
+    rule(NT_CONST_LIST),
+    rule(NT_CONST_MORE, TOK_COMMA, NT_CONST, NT_CONST_MORE),
+    rule(NT_CONST_MORE),
+    rule(NT_CONST, NT_NAME, TOK_EQUAL, NT_CONST_VALUE, BUILD_CONST),
+    rule(NT_CONST_VALUE, TOK_INTEGER, ACT_INTEGER),
+    rule(NT_CONST_VALUE, TOK_CHAR, ACT_CHAR),
+    rule(NT_CONST_VALUE, TOK_IDENTIFIER, ACT_IDENT),
+    rule(NT_CONST_VALUE, TOK_TRUE, ACT_IDENT),
+    rule(NT_CONST_VALUE, TOK_FALSE, ACT_IDENT),
+
+    rule(NT_TYPES, ACT_MARK, NT_TYPE_LIST, BUILD_TYPES),
+    rule(NT_TYPE_LIST, TOK_TYPE, NT_TYPE, TOK_SEMICOLON, NT_TYPE_MORE),
+    rule(NT_TYPE_LIST),
+    rule(NT_TYPE_MORE, NT_TYPE, TOK_SEMICOLON, NT_TYPE_MORE),
+    rule(NT_TYPE_MORE),
+    rule(NT_TYPE, NT_NAME, TOK_EQUAL, NT_LIT, BUILD_TYPE),
+    rule(NT_LIT, TOK_LPAREN, ACT_MARK, NT_NAME, NT_NAME_MORE, TOK_RPAREN, BUILD_LIT),
+
+    rule(NT_DCLNS, ACT_MARK, NT_DCLN_LIST, BUILD_DCLNS),
+    rule(NT_DCLN_LIST, TOK_VAR, NT_DCLN, TOK_SEMICOLON, NT_DCLN_MORE),
+    rule(NT_DCLN_LIST),
+    rule(NT_DCLN_MORE, NT_DCLN, TOK_SEMICOLON, NT_DCLN_MORE),
+    rule(NT_DCLN_MORE),
+    rule(NT_DCLN, ACT_MARK, NT_NAME, NT_NAME_MORE, TOK_COLON, NT_NAME, BUILD_VAR),
+
+    rule(NT_SUBPROGS, ACT_MARK, NT_FCN_LIST, BUILD_SUBPROGS),
+    rule(NT_FCN_LIST, NT_FCN, NT_FCN_LIST),
+    rule(NT_FCN_LIST),
+    rule(NT_FCN, TOK_FUNCTION, NT_NAME, TOK_LPAREN, NT_PARAMS, TOK_RPAREN, TOK_COLON, NT_NAME, TOK_SEMICOLON,
+         NT_CONSTS, NT_TYPES, NT_DCLNS, NT_BLOCK, NT_NAME, TOK_SEMICOLON, BUILD_FCN),
+    rule(NT_PARAMS, ACT_MARK, NT_PARAM_LIST, BUILD_PARAMS),
+    rule(NT_PARAM_LIST, NT_DCLN, NT_PARAM_MORE),
+    rule(NT_PARAM_LIST),
+    rule(NT_PARAM_MORE, TOK_SEMICOLON, NT_DCLN, NT_PARAM_MORE),
+    rule(NT_PARAM_MORE),
+
+    // 'begin' 'end' is an empty block, but a ';' leaves a <null> statement
+    // on either side of it
+    rule(NT_BLOCK, TOK_BEGIN, ACT_MARK, NT_BLOCK_BODY, TOK_END, BUILD_BLOCK),
+    rule(NT_BLOCK_BODY, NT_STMT, NT_STMT_REST),
+    rule(NT_BLOCK_BODY, BUILD_NULL, TOK_SEMICOLON, NT_OPT_STMT, NT_STMT_REST),
+    rule(NT_BLOCK_BODY),
+    rule(NT_STMT_REST, TOK_SEMICOLON, NT_OPT_STMT, NT_STMT_REST),
+    rule(NT_STMT_REST),
+
+    // An identifier after an empty statement could start the next case
+    // label; like the hand-written parser, take it as an assignment
+    preferredRule(NT_OPT_STMT, NT_STMT),
+    rule(NT_OPT_STMT, BUILD_NULL),
+
+    rule(NT_STMT, TOK_IDENTIFIER, ACT_IDENT, NT_ASSIGN_TAIL),
+    rule(NT_STMT, TOK_OUTPUT, TOK_LPAREN, ACT_MARK, NT_OUT_EXP, NT_OUT_MORE, TOK_RPAREN, BUILD_OUTPUT),
+    rule(NT_STMT, TOK_IF, ACT_MARK, NT_EXPR, TOK_THEN, NT_OPT_STMT, NT_ELSE_PART, BUILD_IF),
+    rule(NT_STMT, TOK_WHILE, NT_EXPR, TOK_DO, NT_OPT_STMT, BUILD_WHILE),
+    rule(NT_STMT, TOK_REPEAT, ACT_MARK, NT_OPT_STMT, NT_REPEAT_REST, TOK_UNTIL, NT_EXPR, BUILD_REPEAT),
+    rule(NT_STMT, TOK_FOR, TOK_LPAREN, NT_FOR_STAT, TOK_SEMICOLON, NT_FOR_EXP, TOK_SEMICOLON, NT_FOR_STAT,
+         TOK_RPAREN, NT_OPT_STMT, BUILD_FOR),
+    rule(NT_STMT, TOK_LOOP, ACT_MARK, NT_OPT_STMT, NT_LOOP_REST, TOK_POOL, BUILD_LOOP),
+    rule(NT_STMT, TOK_CASE, ACT_MARK, NT_EXPR, TOK_OF, NT_CLAUSES, NT_OTHERWISE, TOK_END, BUILD_CASE),
+    rule(NT_STMT, TOK_READ, TOK_LPAREN, ACT_MARK, NT_NAME, NT_NAME_MORE, TOK_RPAREN, BUILD_READ),
+    rule(NT_STMT, TOK_EXIT, BUILD_EXIT),
+    rule(NT_STMT, TOK_RETURN, NT_EXPR, BUILD_RETURN),
+    rule(NT_STMT, NT_BLOCK),
+    rule(NT_ASSIGN_TAIL, TOK_ASSIGN, NT_EXPR, BUILD_ASSIGN),
+    rule(NT_ASSIGN_TAIL, TOK_SWAP, NT_NAME, BUILD_SWAP),
+
+    preferredRule(NT_OUT_EXP, TOK_STRING, ACT_STRING, BUILD_OUT_STRING),
+    rule(NT_OUT_EXP, NT_EXPR, BUILD_OUT_INTEGER),
+    rule(NT_OUT_MORE, TOK_COMMA, NT_OUT_EXP, NT_OUT_MORE),
+    rule(NT_OUT_MORE),
+
+    // The else binds to the nearest if
+    preferredRule(NT_ELSE_PART, TOK_ELSE, NT_OPT_STMT),
+    rule(NT_ELSE_PART),
+
+    // A ';' just before 'until' or 'pool' adds no <null> statement
+    rule(NT_REPEAT_REST, TOK_SEMICOLON, NT_REPEAT_NEXT),
+    rule(NT_REPEAT_REST),
+    rule(NT_REPEAT_NEXT, NT_STMT, NT_REPEAT_REST),
+    rule(NT_REPEAT_NEXT, BUILD_NULL, TOK_SEMICOLON, NT_REPEAT_NEXT),
+    rule(NT_REPEAT_NEXT),
+    rule(NT_LOOP_REST, TOK_SEMICOLON, NT_LOOP_NEXT),
+    rule(NT_LOOP_REST),
+    rule(NT_LOOP_NEXT, NT_STMT, NT_LOOP_REST),
+    rule(NT_LOOP_NEXT, BUILD_NULL, TOK_SEMICOLON, NT_LOOP_NEXT),
+    rule(NT_LOOP_NEXT),
+
+    rule(NT_FOR_STAT, TOK_IDENTIFIER, ACT_IDENT, NT_ASSIGN_TAIL),
+    rule(NT_FOR_STAT, BUILD_NULL),
+    rule(NT_FOR_EXP, NT_EXPR),
+    rule(NT_FOR_EXP, BUILD_TRUE),
+
+    // Semicolons between case clauses are optional
+    rule(NT_CLAUSES, NT_CLAUSE, NT_CASE_SEMI, NT_CLAUSES),
+    rule(NT_CLAUSES),
+    rule(NT_CLAUSE, NT_CONST_VALUE, NT_CASE_RANGE, TOK_COLON, NT_OPT_STMT, BUILD_CASE_CLAUSE),
+    rule(NT_CASE_RANGE, TOK_DOTS, NT_CONST_VALUE, BUILD_RANGE),
+    rule(NT_CASE_RANGE),
+    rule(NT_CASE_SEMI, TOK_SEMICOLON),
+    rule(NT_CASE_SEMI),
+    rule(NT_OTHERWISE, TOK_OTHERWISE, NT_OPT_STMT, BUILD_OTHERWISE),
+    rule(NT_OTHERWISE),
+
+    rule(NT_EXPR, NT_TERM, NT_EXPR_TAIL),
+    rule(NT_EXPR_TAIL, TOK_LESS_EQUAL, NT_TERM, BUILD_LE, NT_EXPR_TAIL),
+    rule(NT_EXPR_TAIL, TOK_LESS, NT_TERM, BUILD_LT, NT_EXPR_TAIL),
+    rule(NT_EXPR_TAIL, TOK_GREATER_EQUAL, NT_TERM, BUILD_GE, NT_EXPR_TAIL),
+    rule(NT_EXPR_TAIL, TOK_GREATER, NT_TERM, BUILD_GT, NT_EXPR_TAIL),
+    rule(NT_EXPR_TAIL, TOK_EQUAL, NT_TERM, BUILD_EQ, NT_EXPR_TAIL),
+    rule(NT_EXPR_TAIL, TOK_NOT_EQUAL, NT_TERM, BUILD_NE, NT_EXPR_TAIL),
+    rule(NT_EXPR_TAIL),
+    rule(NT_TERM, NT_FACTOR, NT_TERM_TAIL),
+    rule(NT_TERM_TAIL, TOK_PLUS, NT_FACTOR, BUILD_PLUS, NT_TERM_TAIL),
+    rule(NT_TERM_TAIL, TOK_MINUS, NT_FACTOR, BUILD_MINUS, NT_TERM_TAIL),
+    rule(NT_TERM_TAIL, TOK_OR, NT_FACTOR, BUILD_OR, NT_TERM_TAIL),
+    rule(NT_TERM_TAIL),
+    rule(NT_FACTOR, NT_PRIMARY, NT_FACTOR_TAIL),
+    rule(NT_FACTOR_TAIL, TOK_MULTIPLY, NT_PRIMARY, BUILD_MUL, NT_FACTOR_TAIL),
+    rule(NT_FACTOR_TAIL, TOK_DIVIDE, NT_PRIMARY, BUILD_DIV, NT_FACTOR_TAIL),
+    rule(NT_FACTOR_TAIL, TOK_AND, NT_PRIMARY, BUILD_AND, NT_FACTOR_TAIL),
+    rule(NT_FACTOR_TAIL, TOK_MOD, NT_PRIMARY, BUILD_MOD, NT_FACTOR_TAIL),
+    rule(NT_FACTOR_TAIL),
+
+    rule(NT_PRIMARY, TOK_MINUS, NT_PRIMARY, BUILD_NEG),
+    rule(NT_PRIMARY, TOK_PLUS, NT_PRIMARY),
+    rule(NT_PRIMARY, TOK_NOT, NT_PRIMARY, BUILD_NOT),
+    rule(NT_PRIMARY, TOK_SUCC, TOK_LPAREN, NT_EXPR, TOK_RPAREN, BUILD_SUCC),
+    rule(NT_PRIMARY, TOK_PRED, TOK_LPAREN, NT_EXPR, TOK_RPAREN, BUILD_PRED),
+    rule(NT_PRIMARY, TOK_CHR, TOK_LPAREN, NT_EXPR, TOK_RPAREN, BUILD_CHR),
+    rule(NT_PRIMARY, TOK_ORD, TOK_LPAREN, NT_EXPR, TOK_RPAREN, BUILD_ORD),
+    rule(NT_PRIMARY, TOK_EOF_KW, BUILD_EOF),
+    rule(NT_PRIMARY, TOK_INTEGER, ACT_INTEGER),
+    rule(NT_PRIMARY, TOK_CHAR, ACT_CHAR),
+    rule(NT_PRIMARY, TOK_STRING, ACT_STRING),
+    rule(NT_PRIMARY, TOK_TRUE, ACT_IDENT),
+    rule(NT_PRIMARY, TOK_FALSE, ACT_IDENT),
+    rule(NT_PRIMARY, TOK_LPAREN, NT_EXPR, TOK_RPAREN),
+    rule(NT_PRIMARY, TOK_IDENTIFIER, ACT_IDENT, NT_CALL_TAIL),
+    rule(NT_CALL_TAIL, TOK_LPAREN, ACT_MARK_LAST, NT_ARGS, TOK_RPAREN, BUILD_CALL),
+    rule(NT_CALL_TAIL),
+    rule(NT_ARGS, NT_EXPR, NT_ARG_MORE),
+    rule(NT_ARGS),
+    rule(NT_ARG_MORE, TOK_COMMA, NT_EXPR, NT_ARG_MORE),
+    rule(NT_ARG_MORE),
+};
+
+const unsigned PRODUCTION_COUNT = sizeof(PRODUCTIONS) / sizeof(PRODUCTIONS[0]);
+const uint8_t NO_PRODUCTION = 0xff;
+static_assert(PRODUCTION_COUNT < NO_PRODUCTION, "production numbers must fit the predict table");
+static_assert(NT_COUNT <= 64, "nonterminal sets are 64-bit masks");
+
+// Compile-time tables are built element by element from index packs
+template <unsigned... I> struct Indices {};
+template <class A, class B> struct JoinIndices;
+template <unsigned... A, unsigned... B>
+struct JoinIndices<Indices<A...>, Indices<B...> > {
+    typedef Indices<A..., (sizeof...(A) + B)...> type;
+};
+template <unsigned N> struct MakeIndices {
+    typedef typename JoinIndices<typename MakeIndices<N / 2>::type, typename MakeIndices<N - N / 2>::type>::type type;
+};
+template <> struct MakeIndices<0> { typedef Indices<> type; };
+template <> struct MakeIndices<1> { typedef Indices<0> type; };
+
+struct TokenSet {
+    uint64_t low, high;
+
+    constexpr bool has(unsigned t) const { return t < 64 ? (low >> t) & 1 : (high >> (t - 64)) & 1; }
+    constexpr TokenSet operator|(TokenSet other) const { return TokenSet{low | other.low, high | other.high}; }
+};
+
+constexpr TokenSet noTokens() { return TokenSet{0, 0}; }
+constexpr TokenSet tokenSet(unsigned t) { return t < 64 ? TokenSet{1ULL << t, 0} : TokenSet{0, 1ULL << (t - 64)}; }
+
+constexpr Symbol at(unsigned p, unsigned i) { return i < MAX_RHS ? PRODUCTIONS[p].rhs[i] : END_OF_RHS; }
+
+// Productions of n are [ruleBegin(n), ruleEnd(n)) because the listing keeps
+// them together, which grouped() checks
+constexpr unsigned ruleBegin(unsigned n, unsigned p = 0) {
+    return p == PRODUCTION_COUNT || PRODUCTIONS[p].lhs == n ? p : ruleBegin(n, p + 1);
+}
+constexpr unsigned ruleEndFrom(unsigned n, unsigned p) {
+    return p == PRODUCTION_COUNT || PRODUCTIONS[p].lhs != n ? p : ruleEndFrom(n, p + 1);
+}
+constexpr unsigned ruleEnd(unsigned n) { return ruleEndFrom(n, ruleBegin(n)); }
+constexpr unsigned ruleCount(unsigned n, unsigned lo, unsigned hi) {
+    return hi - lo == 1 ? PRODUCTIONS[lo].lhs == n : ruleCount(n, lo, (lo + hi) / 2) + ruleCount(n, (lo + hi) / 2, hi);
+}
+constexpr bool grouped(unsigned n) {
+    return n == NT_COUNT || (ruleBegin(n) < PRODUCTION_COUNT &&
+                             ruleEnd(n) - ruleBegin(n) == ruleCount(n, 0, PRODUCTION_COUNT) && grouped(n + 1));
+}
+static_assert(grouped(0), "every nonterminal needs productions, listed together");
+
+// Nullable nonterminals, then FIRST sets, each computed once into a table
+// that the later passes read
+constexpr bool nullable(unsigned n);
+constexpr bool nullableFrom(unsigned p, unsigned i) {
+    return at(p, i) == END_OF_RHS ? true
+         : isToken(at(p, i)) ? false
+         : isNonTerminal(at(p, i)) ? nullable(nonTerminalOf(at(p, i))) && nullableFrom(p, i + 1)
+         : nullableFrom(p, i + 1);
+}
+constexpr bool anyNullable(unsigned lo, unsigned hi) {
+    return lo < hi && (nullableFrom(lo, 0) || anyNullable(lo + 1, hi));
+}
+constexpr bool nullable(unsigned n) { return anyNullable(ruleBegin(n), ruleEnd(n)); }
+
+struct NonTerminalFlags { bool flag[NT_COUNT]; };
+template <unsigned... N>
+constexpr NonTerminalFlags makeNullable(Indices<N...>) { return NonTerminalFlags{{nullable(N)...}}; }
+constexpr NonTerminalFlags NULLABLE = makeNullable(MakeIndices<NT_COUNT>::type());
+
+constexpr TokenSet first(unsigned n);
+constexpr TokenSet firstFrom(unsigned p, unsigned i) {
+    return at(p, i) == END_OF_RHS ? noTokens()
+         : isToken(at(p, i)) ? tokenSet(tokenOf(at(p, i)))
+         : isNonTerminal(at(p, i))
+             ? first(nonTerminalOf(at(p, i))) | (NULLABLE.flag[nonTerminalOf(at(p, i))] ? firstFrom(p, i + 1) : noTokens())
+         : firstFrom(p, i + 1);
+}
+constexpr TokenSet firstOfRules(unsigned lo, unsigned hi) {
+    return lo < hi ? firstFrom(lo, 0) | firstOfRules(lo + 1, hi) : noTokens();
+}
+constexpr TokenSet first(unsigned n) { return firstOfRules(ruleBegin(n), ruleEnd(n)); }
+
+struct NonTerminalSets { TokenSet set[NT_COUNT]; };
+template <unsigned... N>
+constexpr NonTerminalSets makeFirst(Indices<N...>) { return NonTerminalSets{{first(N)...}}; }
+constexpr NonTerminalSets FIRST = makeFirst(MakeIndices<NT_COUNT>::type());
+
+// FIRST and nullability of the rest of a right-hand side from position i
+constexpr TokenSet firstOfRest(unsigned p, unsigned i) {
+    return at(p, i) == END_OF_RHS ? noTokens()
+         : isToken(at(p, i)) ? tokenSet(tokenOf(at(p, i)))
+         : isNonTerminal(at(p, i))
+             ? FIRST.set[nonTerminalOf(at(p, i))] | (NULLABLE.flag[nonTerminalOf(at(p, i))] ? firstOfRest(p, i + 1) : noTokens())
+         : firstOfRest(p, i + 1);
+}
+constexpr bool restNullable(unsigned p, unsigned i) {
+    return at(p, i) == END_OF_RHS ? true
+         : isToken(at(p, i)) ? false
+         : isNonTerminal(at(p, i)) ? NULLABLE.flag[nonTerminalOf(at(p, i))] && restNullable(p, i + 1)
+         : restNullable(p, i + 1);
+}
+
+// FOLLOW(n) is what directly follows n in some right-hand side, plus
+// FOLLOW of every left-hand side that n can end. That "can end" relation
+// is closed transitively first, so no set is recomputed along each path.
+constexpr TokenSet directFollowIn(unsigned n, unsigned p, unsigned i) {
+    return at(p, i) == END_OF_RHS ? noTokens()
+         : (at(p, i) == sym(NonTerminal(n)) ? firstOfRest(p, i + 1) : noTokens()) | directFollowIn(n, p, i + 1);
+}
+constexpr TokenSet directFollow(unsigned n, unsigned lo, unsigned hi) {
+    return hi - lo == 1 ? directFollowIn(n, lo, 0) : directFollow(n, lo, (lo + hi) / 2) | directFollow(n, (lo + hi) / 2, hi);
+}
+constexpr uint64_t endsIn(unsigned n, unsigned p, unsigned i) {
+    return at(p, i) == END_OF_RHS ? 0
+         : (at(p, i) == sym(NonTerminal(n)) && restNullable(p, i + 1) ? 1ULL << PRODUCTIONS[p].lhs : 0) | endsIn(n, p, i + 1);
+}
+constexpr uint64_t endsRules(unsigned n, unsigned lo, unsigned hi) {
+    return hi - lo == 1 ? endsIn(n, lo, 0) : endsRules(n, lo, (lo + hi) / 2) | endsRules(n, (lo + hi) / 2, hi);
+}
+
+struct NonTerminalMasks { uint64_t mask[NT_COUNT]; };
+template <unsigned... N>
+constexpr NonTerminalMasks makeEnds(Indices<N...>) { return NonTerminalMasks{{endsRules(N, 0, PRODUCTION_COUNT)...}}; }
+template <unsigned... N>
+constexpr NonTerminalMasks closeOver(NonTerminalMasks m, unsigned k, Indices<N...>) {
+    return NonTerminalMasks{{((m.mask[N] >> k) & 1 ? m.mask[N] | m.mask[k] : m.mask[N])...}};
+}
+constexpr NonTerminalMasks close(NonTerminalMasks m, unsigned k) {
+    return k == NT_COUNT ? m : close(closeOver(m, k, MakeIndices<NT_COUNT>::type()), k + 1);
+}
+constexpr NonTerminalMasks ENDS = close(makeEnds(MakeIndices<NT_COUNT>::type()), 0);
+
+// The program is followed by end of input
+constexpr TokenSet direct(unsigned n) {
+    return directFollow(n, 0, PRODUCTION_COUNT) | (n == NT_PROGRAM ? tokenSet(TOK_EOF) : noTokens());
+}
+template <unsigned... N>
+constexpr NonTerminalSets makeDirect(Indices<N...>) { return NonTerminalSets{{direct(N)...}}; }
+constexpr NonTerminalSets DIRECT_FOLLOW = makeDirect(MakeIndices<NT_COUNT>::type());
+
+constexpr TokenSet follow(unsigned n, unsigned m = 0) {
+    return m == NT_COUNT ? DIRECT_FOLLOW.set[n]
+         : ((ENDS.mask[n] >> m) & 1 ? DIRECT_FOLLOW.set[m] : noTokens()) | follow(n, m + 1);
+}
+template <unsigned... N>
+constexpr NonTerminalSets makeFollow(Indices<N...>) { return NonTerminalSets{{follow(N)...}}; }
+constexpr NonTerminalSets FOLLOW = makeFollow(MakeIndices<NT_COUNT>::type());
+
+// Production p is predicted on token t if t can start it, or if it can
+// derive nothing and t can follow its left-hand side
+struct ProductionSets { TokenSet set[PRODUCTION_COUNT]; };
+template <unsigned... P>
+constexpr ProductionSets makePredicts(Indices<P...>) {
+    return ProductionSets{{(firstOfRest(P, 0) | (restNullable(P, 0) ? FOLLOW.set[PRODUCTIONS[P].lhs] : noTokens()))...}};
+}
+constexpr ProductionSets PREDICTS = makePredicts(MakeIndices<PRODUCTION_COUNT>::type());
+
+constexpr unsigned candidates(unsigned t, unsigned lo, unsigned hi, bool preferredOnly) {
+    return lo == hi ? 0
+         : (PREDICTS.set[lo].has(t) && (!preferredOnly || PRODUCTIONS[lo].preferred)) + candidates(t, lo + 1, hi, preferredOnly);
+}
+constexpr unsigned firstCandidate(unsigned t, unsigned lo, unsigned hi, bool preferredOnly) {
+    return lo == hi ? NO_PRODUCTION
+         : PREDICTS.set[lo].has(t) && (!preferredOnly || PRODUCTIONS[lo].preferred) ? lo
+         : firstCandidate(t, lo + 1, hi, preferredOnly);
+}
+// A cell shared by several productions belongs to the one marked preferred
+constexpr bool conflict(unsigned n, unsigned t) {
+    return candidates(t, ruleBegin(n), ruleEnd(n), false) > 1 && candidates(t, ruleBegin(n), ruleEnd(n), true) != 1;
+}
+constexpr uint8_t predict(unsigned n, unsigned t) {
+    return uint8_t(candidates(t, ruleBegin(n), ruleEnd(n), false) > 1 ? firstCandidate(t, ruleBegin(n), ruleEnd(n), true)
+                                                                      : firstCandidate(t, ruleBegin(n), ruleEnd(n), false));
+}
+
+// Row n, column t is the production to expand n with on token t
+struct PredictTable { uint8_t cell[NT_COUNT * TOKEN_COUNT]; };
+template <unsigned... C>
+constexpr PredictTable makePredictTable(Indices<C...>) {
+    return PredictTable{{predict(C / TOKEN_COUNT, C % TOKEN_COUNT)...}};
+}
+constexpr PredictTable PREDICT = makePredictTable(MakeIndices<NT_COUNT * TOKEN_COUNT>::type());
+
+constexpr unsigned conflicts(unsigned lo, unsigned hi) {
+    return hi - lo == 1 ? conflict(lo / TOKEN_COUNT, lo % TOKEN_COUNT) : conflicts(lo, (lo + hi) / 2) + conflicts((lo + hi) / 2, hi);
+}
+static_assert(conflicts(0, NT_COUNT * TOKEN_COUNT) == 0, "the WinZig grammar is not LL(1)");
+
+// Right-hand side lengths, for pushing a production in reverse
+constexpr unsigned rhsLength(unsigned p, unsigned i = 0) { return at(p, i) == END_OF_RHS ? i : rhsLength(p, i + 1); }
+struct ProductionLengths { uint8_t length[PRODUCTION_COUNT]; };
+template <unsigned... P>
+constexpr ProductionLengths makeLengths(Indices<P...>) { return ProductionLengths{{uint8_t(rhsLength(P))...}}; }
+constexpr ProductionLengths RHS_LENGTH = makeLengths(MakeIndices<PRODUCTION_COUNT>::type());
+
+} // namespace grammar
+
+#endif // WINZIG_GRAMMAR_H